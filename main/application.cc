@@ -11,10 +11,10 @@
 #include "assets/lang_config.h"
 
 #include <cstring>
+#include <algorithm>
 #include <esp_log.h>
 #include <cJSON.h>
 #include <driver/gpio.h>
-#include <arpa/inet.h>
 
 #define TAG "Application"
 
@@ -49,6 +49,11 @@ Application::Application() {
     };
     esp_timer_create(&clock_timer_args, &clock_timer_handle_);
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
+
+    auto ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "audio_output", &audio_output_pm_lock_);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGE(TAG, "Failed to create power management lock: %s", esp_err_to_name(ret));
+    }
 }
 
 Application::~Application() {
@@ -59,10 +64,15 @@ Application::~Application() {
     if (background_task_ != nullptr) {
         delete background_task_;
     }
+    if (audio_output_pm_lock_ != nullptr) {
+        esp_pm_lock_delete(audio_output_pm_lock_);
+    }
     vEventGroupDelete(event_group_);
 }
 
-void Application::CheckNewVersion() {
+// checked is true if the version has just been checked, the result is used without another request.
+// Returns false if the check gave up after too many failures
+bool Application::CheckNewVersion(bool checked) {
     const int MAX_RETRY = 10;
     int retry_count = 0;
     int retry_delay = 10; // 初始重试延迟为10秒
@@ -72,11 +82,11 @@ void Application::CheckNewVersion() {
         auto display = Board::GetInstance().GetDisplay();
         display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
 
-        if (!ota_.CheckVersion()) {
+        if (!checked && !ota_.CheckVersion()) {
             retry_count++;
             if (retry_count >= MAX_RETRY) {
                 ESP_LOGE(TAG, "Too many retries, exit version check");
-                return;
+                return false;
             }
             ESP_LOGW(TAG, "Check new version failed, retry in %d seconds (%d/%d)", retry_delay, retry_count, MAX_RETRY);
             for (int i = 0; i < retry_delay; i++) {
@@ -88,6 +98,7 @@ void Application::CheckNewVersion() {
             retry_delay *= 2; // 每次重试后延迟时间翻倍
             continue;
         }
+        checked = false;
         retry_count = 0;
         retry_delay = 10; // 重置重试延迟时间
 
@@ -115,6 +126,7 @@ void Application::CheckNewVersion() {
                 std::lock_guard<std::mutex> lock(mutex_);
                 audio_decode_queue_.clear();
             }
+            sound_player_.Clear();
             background_task_->WaitForCompletion();
             delete background_task_;
             background_task_ = nullptr;
@@ -131,15 +143,14 @@ void Application::CheckNewVersion() {
             ESP_LOGI(TAG, "Firmware upgrade failed...");
             vTaskDelay(pdMS_TO_TICKS(3000));
             Reboot();
-            return;
+            return false;
         }
 
         // No new version, mark the current version as valid
         ota_.MarkCurrentVersionValid();
         if (!ota_.HasActivationCode() && !ota_.HasActivationChallenge()) {
-            xEventGroupSetBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT);
-            // Exit the loop if done checking new version
-            break;
+            // Done checking new version
+            return true;
         }
 
         display->SetStatus(Lang::Strings::ACTIVATION);
@@ -153,7 +164,6 @@ void Application::CheckNewVersion() {
             ESP_LOGI(TAG, "Activating... %d/%d", i + 1, 10);
             esp_err_t err = ota_.Activate();
             if (err == ESP_OK) {
-                xEventGroupSetBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT);
                 break;
             } else if (err == ESP_ERR_TIMEOUT) {
                 vTaskDelay(pdMS_TO_TICKS(3000));
@@ -167,13 +177,62 @@ void Application::CheckNewVersion() {
     }
 }
 
+// Conditional check against the cached config, only takes over the device if the user needs to see the result
+void Application::CheckNewVersionInBackground() {
+    int64_t start = esp_timer_get_time();
+    if (!ota_.CheckVersion()) {
+        ESP_LOGW(TAG, "Background version check failed, keep using the cached config");
+        return;
+    }
+    LogBootStage("background version check", start);
+
+    if (ota_.HasNewVersion() || ota_.HasActivationCode() || ota_.HasActivationChallenge()) {
+        // Do not interrupt a conversation, take over the device now if it is idle,
+        // otherwise SetDeviceState does when the device returns to idle
+        xEventGroupClearBits(event_group_, VERSION_ACTION_READY_EVENT);
+        version_action_pending_ = true;
+        Schedule([this]() {
+            ClaimDeviceForVersionAction();
+        });
+        xEventGroupWaitBits(event_group_, VERSION_ACTION_READY_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+
+        // The upgrade or the activation runs on this task, with the result of the check above
+        CheckNewVersion(true);
+        Schedule([this]() {
+            if (ota_.TakeMqttConfigChanged()) {
+                ESP_LOGI(TAG, "MQTT config changed, restarting protocol");
+                protocol_->Start();
+            }
+            SetDeviceState(kDeviceStateIdle);
+        });
+        return;
+    }
+
+    ota_.MarkCurrentVersionValid();
+    if (ota_.TakeMqttConfigChanged()) {
+        Schedule([this]() {
+            ESP_LOGI(TAG, "MQTT config changed, restarting protocol");
+            protocol_->Start();
+        });
+    }
+}
+
+// Runs on the main task, the device is taken over once for the pending version action
+void Application::ClaimDeviceForVersionAction() {
+    if (device_state_ != kDeviceStateIdle || !version_action_pending_.exchange(false)) {
+        return;
+    }
+    SetDeviceState(kDeviceStateActivating);
+    xEventGroupSetBits(event_group_, VERSION_ACTION_READY_EVENT);
+}
+
 void Application::ShowActivationCode() {
     auto& message = ota_.GetActivationMessage();
     auto& code = ota_.GetActivationCode();
 
     struct digit_sound {
         char digit;
-        const std::string_view& sound;
+        std::string_view sound;
     };
     static const std::array<digit_sound, 10> digit_sounds{{
         digit_sound{'0', Lang::Sounds::P3_0},
@@ -188,7 +247,7 @@ void Application::ShowActivationCode() {
         digit_sound{'9', Lang::Sounds::P3_9}
     }};
 
-    // This sentence uses 9KB of SRAM, so we need to wait for it to finish
+    // The digits are queued right after the message and played without gaps
     Alert(Lang::Strings::ACTIVATION, message.c_str(), "happy", Lang::Sounds::P3_ACTIVATION);
 
     for (const auto& digit : code) {
@@ -207,7 +266,7 @@ void Application::Alert(const char* status, const char* message, const char* emo
     display->SetEmotion(emotion);
     display->SetChatMessage("system", message);
     if (!sound.empty()) {
-        ResetDecoder();
+        // The sound is mixed over the server audio, no need to reset the decoder
         PlaySound(sound);
     }
 }
@@ -222,32 +281,12 @@ void Application::DismissAlert() {
 }
 
 void Application::PlaySound(const std::string_view& sound) {
-    // Wait for the previous sound to finish
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        audio_decode_cv_.wait(lock, [this]() {
-            return audio_decode_queue_.empty();
-        });
-    }
-    background_task_->WaitForCompletion();
-
-    // The assets are encoded at 16000Hz, 60ms frame duration
-    SetDecodeSampleRate(16000, 60);
-    const char* data = sound.data();
-    size_t size = sound.size();
-    for (const char* p = data; p < data + size; ) {
-        auto p3 = (BinaryProtocol3*)p;
-        p += sizeof(BinaryProtocol3);
+    sound_player_.Play(sound);
 
-        auto payload_size = ntohs(p3->payload_size);
-        std::vector<uint8_t> opus;
-        opus.resize(payload_size);
-        memcpy(opus.data(), p3->payload, payload_size);
-        p += payload_size;
-
-        std::lock_guard<std::mutex> lock(mutex_);
-        audio_decode_queue_.emplace_back(std::move(opus));
-    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_output_time_ = std::chrono::steady_clock::now();
+    auto codec = Board::GetInstance().GetAudioCodec();
+    codec->EnableOutput(true);
 }
 
 void Application::ToggleChatState() {
@@ -333,13 +372,16 @@ void Application::StopListening() {
 void Application::Start() {
     auto& board = Board::GetInstance();
     SetDeviceState(kDeviceStateStarting);
+    int64_t boot_start = esp_timer_get_time();
+    int64_t stage_start = boot_start;
 
     /* Setup the display */
     auto display = board.GetDisplay();
 
     /* Setup the audio codec */
     auto codec = board.GetAudioCodec();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
+    decoder_pool_.Initialize(codec->output_sample_rate());
+    opus_decoder_ = decoder_pool_.Acquire(codec->output_sample_rate(), OPUS_FRAME_DURATION_MS);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
     if (realtime_chat_enabled_) {
         ESP_LOGI(TAG, "Realtime chat enabled, setting opus encoder complexity to 0");
@@ -356,6 +398,17 @@ void Application::Start() {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
     }
+
+    sound_player_.Initialize(&decoder_pool_, codec->output_sample_rate());
+    audio_mixer_.Initialize(codec->output_sample_rate());
+    // Lower the voice while a notification sound is playing
+    audio_mixer_.SetDucking(kAudioMixerChannelVoice, kAudioMixerChannelSound, 0.3f);
+#if CONFIG_SPIRAM
+    // Keep the most frequent short sounds decoded in PSRAM
+    sound_player_.Preload(Lang::Sounds::P3_SUCCESS);
+    sound_player_.Preload(Lang::Sounds::P3_VIBRATION);
+    sound_player_.Preload(Lang::Sounds::P3_EXCLAMATION);
+#endif
     codec->Start();
 
     xTaskCreatePinnedToCore([](void* arg) {
@@ -363,12 +416,32 @@ void Application::Start() {
         app->AudioLoop();
         vTaskDelete(NULL);
     }, "audio_loop", 4096 * 2, this, 8, &audio_loop_task_handle_, realtime_chat_enabled_ ? 1 : 0);
+    LogBootStage("audio", stage_start);
+
+#if CONFIG_USE_AUDIO_PROCESSOR || CONFIG_USE_WAKE_WORD_DETECT
+    // Load the ESP-SR models and create the AFE while the network is connecting
+    xTaskCreate([](void* arg) {
+        Application* app = (Application*)arg;
+        int64_t start = esp_timer_get_time();
+        auto codec = Board::GetInstance().GetAudioCodec();
+#if CONFIG_USE_AUDIO_PROCESSOR
+        app->audio_processor_.Initialize(codec, app->realtime_chat_enabled_);
+#endif
+#if CONFIG_USE_WAKE_WORD_DETECT
+        app->wake_word_detect_.Initialize(codec);
+#endif
+        app->LogBootStage("audio frontend", start);
+        xEventGroupSetBits(app->event_group_, AUDIO_FRONTEND_READY_EVENT);
+        vTaskDelete(NULL);
+    }, "afe_init", 4096 * 2, this, 2, NULL);
+#else
+    xEventGroupSetBits(event_group_, AUDIO_FRONTEND_READY_EVENT);
+#endif
 
     /* Wait for the network to be ready */
+    stage_start = esp_timer_get_time();
     board.StartNetwork();
-
-    // Check for new firmware version or get the MQTT broker address
-    CheckNewVersion();
+    LogBootStage("network", stage_start);
 
     // Initialize the protocol
     display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
@@ -378,6 +451,14 @@ void Application::Start() {
     protocol_ = std::make_unique<MqttProtocol>();
 #endif
     protocol_->OnNetworkError([this](const std::string& message) {
+        if (device_state_ == kDeviceStateStarting) {
+            // The protocol may start in parallel with the boot, report the error once the boot is done
+            Schedule([this, message]() {
+                SetDeviceState(kDeviceStateIdle);
+                Alert(Lang::Strings::ERROR, message.c_str(), "sad", Lang::Sounds::P3_EXCLAMATION);
+            });
+            return;
+        }
         SetDeviceState(kDeviceStateIdle);
         Alert(Lang::Strings::ERROR, message.c_str(), "sad", Lang::Sounds::P3_EXCLAMATION);
     });
@@ -388,6 +469,26 @@ void Application::Start() {
             audio_decode_queue_.emplace_back(std::move(data));
         }
     });
+    // Property changes are pushed while the channel is open, batched by the thing manager
+    iot::ThingManager::GetInstance().OnStatesChanged([this]() {
+        Schedule([this]() {
+            if (protocol_ && protocol_->IsAudioChannelOpened()) {
+                UpdateIotStates();
+            }
+        });
+    });
+    // IoT commands run on the thing worker, the results are reported from the main loop.
+    // Methods that touch the codec, the display or the LEDs are still run by the main loop
+    iot::ThingManager::GetInstance().SetMainTaskScheduler([this](std::function<void()> callback) {
+        Schedule(std::move(callback));
+    });
+    iot::ThingManager::GetInstance().OnInvokeResult([this](const std::string& result) {
+        Schedule([this, result]() {
+            if (protocol_ && protocol_->IsAudioChannelOpened()) {
+                protocol_->SendIotResult(result);
+            }
+        });
+    });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
         board.SetPowerSaveMode(false);
         if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
@@ -396,7 +497,7 @@ void Application::Start() {
         }
         SetDecodeSampleRate(protocol_->server_sample_rate(), protocol_->server_frame_duration());
         auto& thing_manager = iot::ThingManager::GetInstance();
-        protocol_->SendIotDescriptors(thing_manager.GetDescriptorsJson());
+        protocol_->SendIotDescriptors(thing_manager.GetDescriptors());
         std::string states;
         if (thing_manager.GetStatesJson(states, false)) {
             protocol_->SendIotStates(states);
@@ -437,8 +538,14 @@ void Application::Start() {
                 auto text = cJSON_GetObjectItem(root, "text");
                 if (text != NULL) {
                     ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
+                    // The sentence is shown when the voice queued after it starts playing
+                    int64_t start_ms;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        start_ms = voice_position_ms_ + (int64_t)audio_decode_queue_.size() * protocol_->server_frame_duration();
+                    }
+                    Schedule([this, display, message = std::string(text->valuestring), start_ms]() {
+                        display->AppendChatMessage("assistant", message.c_str(), start_ms);
                     });
                 }
             }
@@ -490,10 +597,38 @@ void Application::Start() {
             }
         }
     });
-    protocol_->Start();
+
+    // With the config of the last check the device does not wait for the server,
+    // the check runs in the background once the device is ready
+    bool cached_config = ota_.LoadCachedConfig();
+    if (cached_config) {
+        // Connect with the saved broker address while the audio frontend is loading
+        xTaskCreate([](void* arg) {
+            Application* app = (Application*)arg;
+            int64_t start = esp_timer_get_time();
+            app->protocol_->Start();
+            app->LogBootStage("protocol", start);
+            xEventGroupSetBits(app->event_group_, PROTOCOL_STARTED_EVENT);
+            vTaskDelete(NULL);
+        }, "protocol_start", 4096 * 2, this, 3, NULL);
+    } else {
+        // Check for new firmware version or get the MQTT broker address
+        stage_start = esp_timer_get_time();
+        if (CheckNewVersion()) {
+            xEventGroupSetBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT);
+        }
+        LogBootStage("version check", stage_start);
+
+        stage_start = esp_timer_get_time();
+        protocol_->Start();
+        LogBootStage("protocol", stage_start);
+    }
+
+    stage_start = esp_timer_get_time();
+    xEventGroupWaitBits(event_group_, AUDIO_FRONTEND_READY_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+    LogBootStage("wait audio frontend", stage_start);
 
 #if CONFIG_USE_AUDIO_PROCESSOR
-    audio_processor_.Initialize(codec, realtime_chat_enabled_);
     audio_processor_.OnOutput([this](std::vector<int16_t>&& data) {
         background_task_->Schedule([this, data = std::move(data)]() mutable {
             if (protocol_->IsAudioChannelBusy()) {
@@ -522,7 +657,6 @@ void Application::Start() {
 #endif
 
 #if CONFIG_USE_WAKE_WORD_DETECT
-    wake_word_detect_.Initialize(codec);
     wake_word_detect_.OnWakeWordDetected([this](const std::string& wake_word) {
         Schedule([this, &wake_word]() {
             if (device_state_ == kDeviceStateIdle) {
@@ -553,8 +687,12 @@ void Application::Start() {
     wake_word_detect_.StartDetection();
 #endif
 
-    // Wait for the new version check to finish
-    xEventGroupWaitBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+    // Wait for the new version check or the protocol started in parallel to finish
+    if (cached_config) {
+        xEventGroupWaitBits(event_group_, PROTOCOL_STARTED_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+    } else {
+        xEventGroupWaitBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+    }
     SetDeviceState(kDeviceStateIdle);
     std::string message = std::string(Lang::Strings::VERSION) + ota_.GetCurrentVersion();
     display->ShowNotification(message.c_str());
@@ -562,11 +700,27 @@ void Application::Start() {
     // Play the success sound to indicate the device is ready
     ResetDecoder();
     PlaySound(Lang::Sounds::P3_SUCCESS);
-    
+    LogBootStage("ready", boot_start);
+
+    if (cached_config) {
+        xTaskCreate([](void* arg) {
+            Application* app = (Application*)arg;
+            app->CheckNewVersionInBackground();
+            app->check_new_version_task_handle_ = nullptr;
+            vTaskDelete(NULL);
+        }, "check_new_version", 4096 * 2, this, 2, &check_new_version_task_handle_);
+    }
+
     // Enter the main event loop
     MainEventLoop();
 }
 
+// Time since power on is included, it is the time-to-ready of the device
+void Application::LogBootStage(const char* stage, int64_t start_time) {
+    int64_t now = esp_timer_get_time();
+    ESP_LOGI(TAG, "Boot stage %s: %lld ms, since power on %lld ms", stage, (now - start_time) / 1000, now / 1000);
+}
+
 void Application::OnClockTimer() {
     clock_ticks_++;
 
@@ -577,6 +731,7 @@ void Application::OnClockTimer() {
         int free_sram = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
         int min_free_sram = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
         ESP_LOGI(TAG, "Free internal: %u minimal internal: %u", free_sram, min_free_sram);
+        LogPowerStats();
 
         // If we have synchronized server time, set the status to clock "HH:MM" if the device is idle
         if (ota_.HasServerTime()) {
@@ -593,6 +748,32 @@ void Application::OnClockTimer() {
     }
 }
 
+// CPU busy time and wakeups are a proxy of the current draw, to compare the power of builds
+void Application::LogPowerStats() {
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - last_power_stats_time_;
+    last_power_stats_time_ = now;
+
+    std::string busy;
+    for (int core = 0; core < configNUMBER_OF_CORES; core++) {
+        // The run time counter is in microseconds
+        uint32_t idle = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        uint32_t idle_elapsed = idle - last_idle_run_time_[core];
+        last_idle_run_time_[core] = idle;
+        int percent = elapsed > 0 ? 100 - std::min<int64_t>(idle_elapsed * 100 / elapsed, 100) : 0;
+        busy += " " + std::to_string(percent) + "%";
+    }
+
+    uint32_t wakeups = audio_loop_wakeups_.exchange(0);
+    int wakeups_per_second = elapsed > 0 ? wakeups * 1000000LL / elapsed : 0;
+#if CONFIG_USE_WAKE_WORD_DETECT
+    ESP_LOGI(TAG, "CPU busy:%s, audio wakeups: %d/s, wake word fed: %d%%", busy.c_str(), wakeups_per_second,
+        wake_word_detect_.GetFedPercent());
+#else
+    ESP_LOGI(TAG, "CPU busy:%s, audio wakeups: %d/s", busy.c_str(), wakeups_per_second);
+#endif
+}
+
 // Add a async task to MainLoop
 void Application::Schedule(std::function<void()> callback) {
     {
@@ -624,6 +805,7 @@ void Application::MainEventLoop() {
 void Application::AudioLoop() {
     auto codec = Board::GetInstance().GetAudioCodec();
     while (true) {
+        audio_loop_wakeups_++;
         OnAudioInput();
         if (codec->output_enabled()) {
             OnAudioOutput();
@@ -641,7 +823,21 @@ void Application::OnAudioOutput() {
     const int max_silence_seconds = 10;
 
     std::unique_lock<std::mutex> lock(mutex_);
-    if (audio_decode_queue_.empty()) {
+    if (device_state_ == kDeviceStateListening) {
+        // Drop the server voice, local sounds keep playing
+        audio_decode_queue_.clear();
+        audio_mixer_.Clear(kAudioMixerChannelVoice);
+    }
+
+    // Decode the next server packet only when the mixer has consumed the previous one
+    std::vector<uint8_t> opus;
+    if (!audio_decode_queue_.empty() && audio_mixer_.Available(kAudioMixerChannelVoice) == 0) {
+        opus = std::move(audio_decode_queue_.front());
+        audio_decode_queue_.pop_front();
+    }
+    lock.unlock();
+
+    if (opus.empty() && !sound_player_.IsPlaying() && audio_mixer_.IsEmpty()) {
         // Disable the output if there is no audio data for a long time
         if (device_state_ == kDeviceStateIdle) {
             auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - last_output_time_).count();
@@ -652,37 +848,38 @@ void Application::OnAudioOutput() {
         return;
     }
 
-    if (device_state_ == kDeviceStateListening) {
-        audio_decode_queue_.clear();
-        audio_decode_cv_.notify_all();
-        return;
-    }
-
-    auto opus = std::move(audio_decode_queue_.front());
-    audio_decode_queue_.pop_front();
-    lock.unlock();
-    audio_decode_cv_.notify_all();
-
     busy_decoding_audio_ = true;
+    if (audio_output_pm_lock_ != nullptr) {
+        esp_pm_lock_acquire(audio_output_pm_lock_);
+    }
     background_task_->Schedule([this, codec, opus = std::move(opus)]() mutable {
         busy_decoding_audio_ = false;
-        if (aborted_) {
-            return;
+
+        if (!opus.empty() && !aborted_) {
+            std::vector<int16_t> pcm;
+            // Resampled to the output sample rate if the sample rate is different
+            if (opus_decoder_->Decode(std::move(opus), pcm)) {
+                audio_mixer_.Write(kAudioMixerChannelVoice, pcm);
+            }
+            voice_position_ms_ += opus_decoder_->decoder->duration_ms();
+            Board::GetInstance().GetDisplay()->SetPlaybackPosition(voice_position_ms_);
+        }
+
+        if (audio_mixer_.Available(kAudioMixerChannelSound) == 0) {
+            std::vector<int16_t> pcm;
+            if (sound_player_.Read(pcm)) {
+                audio_mixer_.Write(kAudioMixerChannelSound, pcm);
+            }
         }
 
         std::vector<int16_t> pcm;
-        if (!opus_decoder_->Decode(std::move(opus), pcm)) {
-            return;
+        if (audio_mixer_.Mix(pcm)) {
+            codec->OutputData(pcm);
+            last_output_time_ = std::chrono::steady_clock::now();
         }
-        // Resample if the sample rate is different
-        if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-            int target_size = output_resampler_.GetOutputSamples(pcm.size());
-            std::vector<int16_t> resampled(target_size);
-            output_resampler_.Process(pcm.data(), pcm.size(), resampled.data());
-            pcm = std::move(resampled);
+        if (audio_output_pm_lock_ != nullptr) {
+            esp_pm_lock_release(audio_output_pm_lock_);
         }
-        codec->OutputData(pcm);
-        last_output_time_ = std::chrono::steady_clock::now();
     });
 }
 
@@ -802,6 +999,11 @@ void Application::SetDeviceState(DeviceState state) {
 #if CONFIG_USE_WAKE_WORD_DETECT
             wake_word_detect_.StartDetection();
 #endif
+            if (version_action_pending_) {
+                Schedule([this]() {
+                    ClaimDeviceForVersionAction();
+                });
+            }
             break;
         case kDeviceStateConnecting:
             display->SetStatus(Lang::Strings::CONNECTING);
@@ -857,9 +1059,9 @@ void Application::SetDeviceState(DeviceState state) {
 
 void Application::ResetDecoder() {
     std::lock_guard<std::mutex> lock(mutex_);
-    opus_decoder_->ResetState();
+    opus_decoder_->decoder->ResetState();
     audio_decode_queue_.clear();
-    audio_decode_cv_.notify_all();
+    audio_mixer_.Clear(kAudioMixerChannelVoice);
     last_output_time_ = std::chrono::steady_clock::now();
     
     auto codec = Board::GetInstance().GetAudioCodec();
@@ -867,18 +1069,14 @@ void Application::ResetDecoder() {
 }
 
 void Application::SetDecodeSampleRate(int sample_rate, int frame_duration) {
-    if (opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
+    if (opus_decoder_->decoder->sample_rate() == sample_rate && opus_decoder_->decoder->duration_ms() == frame_duration) {
         return;
     }
 
-    opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
-
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
-    }
+    // Swap to a pooled decoder, the previous one is kept for the next switch back
+    auto decoder = decoder_pool_.Acquire(sample_rate, frame_duration);
+    decoder_pool_.Release(opus_decoder_);
+    opus_decoder_ = decoder;
 }
 
 void Application::UpdateIotStates() {
@@ -5,12 +5,14 @@
 #include <freertos/event_groups.h>
 #include <freertos/task.h>
 #include <esp_timer.h>
+#include <esp_pm.h>
 
 #include <string>
 #include <mutex>
 #include <list>
 #include <vector>
 #include <condition_variable>
+#include <atomic>
 
 #include <opus_encoder.h>
 #include <opus_decoder.h>
@@ -19,6 +21,9 @@
 #include "protocol.h"
 #include "ota.h"
 #include "background_task.h"
+#include "sound_player.h"
+#include "audio_mixer.h"
+#include "opus_decoder_pool.h"
 
 #if CONFIG_USE_WAKE_WORD_DETECT
 #include "wake_word_detect.h"
@@ -31,6 +36,9 @@
 #define AUDIO_INPUT_READY_EVENT (1 << 1)
 #define AUDIO_OUTPUT_READY_EVENT (1 << 2)
 #define CHECK_NEW_VERSION_DONE_EVENT (1 << 3)
+#define AUDIO_FRONTEND_READY_EVENT (1 << 4)
+#define PROTOCOL_STARTED_EVENT (1 << 5)
+#define VERSION_ACTION_READY_EVENT (1 << 6)
 
 enum DeviceState {
     kDeviceStateUnknown,
@@ -100,22 +108,35 @@ private:
     bool aborted_ = false;
     bool voice_detected_ = false;
     bool busy_decoding_audio_ = false;
+    // Total duration of the server voice decoded so far, used to pace the chat text
+    std::atomic<int64_t> voice_position_ms_ = 0;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
+    // The background version check waits for the device to be idle to upgrade or activate
+    std::atomic<bool> version_action_pending_ = false;
+
+    // Power metrics, reported with the clock timer
+    std::atomic<uint32_t> audio_loop_wakeups_ = 0;
+    uint32_t last_idle_run_time_[configNUMBER_OF_CORES] = {0};
+    int64_t last_power_stats_time_ = 0;
 
     // Audio encode / decode
     TaskHandle_t audio_loop_task_handle_ = nullptr;
+    // Keep the CPU at full speed while decoding and mixing the output
+    esp_pm_lock_handle_t audio_output_pm_lock_ = nullptr;
     BackgroundTask* background_task_ = nullptr;
     std::chrono::steady_clock::time_point last_output_time_;
     std::list<std::vector<uint8_t>> audio_decode_queue_;
-    std::condition_variable audio_decode_cv_;
 
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
-    std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
+    OpusDecoderPool decoder_pool_;
+    PooledOpusDecoder* opus_decoder_ = nullptr;
+
+    SoundPlayer sound_player_;
+    AudioMixer audio_mixer_;
 
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
 
     void MainEventLoop();
     void OnAudioInput();
@@ -123,11 +144,15 @@ private:
     void ReadAudio(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
-    void CheckNewVersion();
+    bool CheckNewVersion(bool checked = false);
+    void CheckNewVersionInBackground();
+    void ClaimDeviceForVersionAction();
     void ShowActivationCode();
     void OnClockTimer();
     void SetListeningMode(ListeningMode mode);
     void AudioLoop();
+    void LogBootStage(const char* stage, int64_t start_time);
+    void LogPowerStats();
 };
 
 #endif // _APPLICATION_H_
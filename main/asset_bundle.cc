@@ -0,0 +1,88 @@
+#include "asset_bundle.h"
+#include "assets/lang_config.h"
+
+#include <esp_log.h>
+#include <cstring>
+
+#define TAG "AssetBundle"
+
+#define ASSET_PARTITION_LABEL "assets"
+
+AssetBundle::AssetBundle() {
+    Load();
+}
+
+AssetBundle::~AssetBundle() {
+    if (bundle_ != nullptr) {
+        esp_partition_munmap(mmap_handle_);
+    }
+}
+
+void AssetBundle::Load() {
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ASSET_PARTITION_LABEL);
+    if (partition == nullptr) {
+        ESP_LOGE(TAG, "No assets partition");
+        return;
+    }
+
+    // Only map the bundle itself, not the whole partition
+    AssetBundleHeader header;
+    esp_err_t err = esp_partition_read(partition, 0, &header, sizeof(header));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read assets header: %s", esp_err_to_name(err));
+        return;
+    }
+    if (header.magic != ASSET_BUNDLE_MAGIC || header.version != ASSET_BUNDLE_VERSION ||
+        header.total_size > partition->size ||
+        sizeof(AssetBundleHeader) + header.count * sizeof(AssetBundleEntry) > header.total_size) {
+        ESP_LOGE(TAG, "Assets partition does not contain a valid bundle, flash it with `idf.py flash`");
+        return;
+    }
+    // 固件升级后音效有增减，旧的 assets 分区不再适用
+    if (header.signature != Lang::ASSETS_SIGNATURE) {
+        ESP_LOGE(TAG, "Assets bundle is stale (signature %08lx, firmware expects %08lx), flash it with `idf.py flash`",
+            header.signature, Lang::ASSETS_SIGNATURE);
+        return;
+    }
+
+    const void* data = nullptr;
+    err = esp_partition_mmap(partition, 0, header.total_size, ESP_PARTITION_MMAP_DATA, &data, &mmap_handle_);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map assets partition: %s", esp_err_to_name(err));
+        return;
+    }
+    bundle_ = (const uint8_t*)data;
+    header_ = (const AssetBundleHeader*)bundle_;
+    entries_ = (const AssetBundleEntry*)(bundle_ + sizeof(AssetBundleHeader));
+    ESP_LOGI(TAG, "Loaded %u assets, %lu bytes", header_->count, header_->total_size);
+}
+
+std::string_view AssetBundle::Find(const char* name) const {
+    if (header_ == nullptr) {
+        ESP_LOGE(TAG, "Asset %s unavailable, no valid bundle in the assets partition", name);
+        return std::string_view();
+    }
+
+    // Entries are sorted by name
+    int low = 0;
+    int high = header_->count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        auto& entry = entries_[mid];
+        int cmp = strncmp(name, entry.name, ASSET_BUNDLE_NAME_SIZE);
+        if (cmp == 0) {
+            if (entry.offset + entry.size > header_->total_size) {
+                ESP_LOGE(TAG, "Invalid asset %s", name);
+                return std::string_view();
+            }
+            return std::string_view((const char*)bundle_ + entry.offset, entry.size);
+        }
+        if (cmp < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    ESP_LOGW(TAG, "Asset %s not found", name);
+    return std::string_view();
+}
@@ -0,0 +1,80 @@
+#ifndef ASSET_BUNDLE_H
+#define ASSET_BUNDLE_H
+
+#include <esp_partition.h>
+
+#include <string_view>
+#include <cstdint>
+
+// Asset bundle in the "assets" partition, generated by scripts/asset_bundle.py.
+// The bundle is memory mapped once, lookups return views of the flash data.
+//
+// Layout (little endian):
+//   header  AssetBundleHeader, signature is the FNV-1a of the sorted asset names
+//           and must match Lang::ASSETS_SIGNATURE of the firmware
+//   entries AssetBundleEntry[count], sorted by name
+//   data    blobs aligned to ASSET_BUNDLE_ALIGN bytes
+#define ASSET_BUNDLE_MAGIC 0x42545341  // "ASTB"
+#define ASSET_BUNDLE_VERSION 2
+#define ASSET_BUNDLE_NAME_SIZE 32
+#define ASSET_BUNDLE_ALIGN 4
+
+struct AssetBundleHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t total_size;
+    uint32_t signature;
+};
+
+struct AssetBundleEntry {
+    char name[ASSET_BUNDLE_NAME_SIZE];
+    uint32_t offset;
+    uint32_t size;
+};
+
+class AssetBundle {
+public:
+    static AssetBundle& GetInstance() {
+        static AssetBundle instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    AssetBundle(const AssetBundle&) = delete;
+    AssetBundle& operator=(const AssetBundle&) = delete;
+
+    // Returns an empty view if the asset does not exist
+    std::string_view Find(const char* name) const;
+
+    inline bool loaded() const { return header_ != nullptr; }
+
+private:
+    AssetBundle();
+    ~AssetBundle();
+
+    esp_partition_mmap_handle_t mmap_handle_ = 0;
+    const uint8_t* bundle_ = nullptr;
+    const AssetBundleHeader* header_ = nullptr;
+    const AssetBundleEntry* entries_ = nullptr;
+
+    void Load();
+};
+
+// Named reference to an asset, used by the generated lang_config.h in place of
+// the embedded file symbols. Converts to the asset data on use, or to the copy
+// embedded in the firmware when the bundle is missing or stale.
+struct AssetRef {
+    const char* name;
+    const char* fallback_start = nullptr;
+    const char* fallback_end = nullptr;
+
+    operator std::string_view() const {
+        auto& bundle = AssetBundle::GetInstance();
+        if (!bundle.loaded() && fallback_start != nullptr) {
+            return std::string_view(fallback_start, fallback_end - fallback_start);
+        }
+        return bundle.Find(name);
+    }
+};
+
+#endif // ASSET_BUNDLE_H
@@ -1,13 +1,18 @@
 #include "audio_codec.h"
 #include "board.h"
 #include "settings.h"
+#include "iot/thing_manager.h"
 
 #include <esp_log.h>
 #include <cstring>
+#include <algorithm>
 #include <driver/i2s_common.h>
 
 #define TAG "AudioCodec"
 
+// 参考信号延迟的测量范围，在按 DMA 深度估算的位置前后搜索
+#define REFERENCE_DELAY_SEARCH_MS 80
+
 AudioCodec::AudioCodec() {
 }
 
@@ -16,14 +21,119 @@ AudioCodec::~AudioCodec() {
 
 void AudioCodec::OutputData(std::vector<int16_t>& data) {
     Write(data.data(), data.size());
+    if (software_reference_ && output_enabled_) {
+        PushReference(data);
+    }
 }
 
 bool AudioCodec::InputData(std::vector<int16_t>& data) {
-    int samples = Read(data.data(), data.size());
-    if (samples > 0) {
-        return true;
+    if (!software_reference_) {
+        int samples = Read(data.data(), data.size());
+        if (samples > 0) {
+            return true;
+        }
+        return false;
+    }
+
+    // 读取麦克风数据，再把参考信号交织为最后一个通道
+    int channels = input_channels_ + 1;
+    std::vector<int16_t> mic(data.size() / channels * input_channels_);
+    int samples = Read(mic.data(), mic.size());
+    if (samples <= 0) {
+        return false;
+    }
+    int frames = samples / input_channels_;
+    data.resize(frames * channels);
+
+    std::vector<int16_t> first_mic(frames);
+    std::vector<int16_t> reference(frames);
+    {
+        std::lock_guard<std::mutex> lock(reference_mutex_);
+        for (int i = 0, j = 0, k = 0; i < frames; i++) {
+            first_mic[i] = mic[k];
+            for (int c = 0; c < input_channels_; c++) {
+                data[j++] = mic[k++];
+            }
+            reference[i] = reference_read_pos_ < reference_buffer_.size() ? reference_buffer_[reference_read_pos_++] : 0;
+            data[j++] = reference[i];
+        }
+        if (reference_read_pos_ == reference_buffer_.size()) {
+            reference_buffer_.clear();
+            reference_read_pos_ = 0;
+        }
+    }
+
+    // 用实际的回声测量参考信号的偏移，修正初始估算以及播放中断、漂移造成的错位
+    int correction = delay_estimator_.Process(first_mic.data(), reference.data(), frames);
+    if (correction != 0) {
+        AdjustReferenceDelay(correction);
+    }
+    return true;
+}
+
+void AudioCodec::AdjustReferenceDelay(int correction) {
+    std::lock_guard<std::mutex> lock(reference_mutex_);
+    if (correction > 0) {
+        // 参考信号超前，在读取位置插入静音
+        reference_buffer_.insert(reference_buffer_.begin() + reference_read_pos_, correction, 0);
+    } else {
+        // 参考信号滞后，丢弃读取位置之后的数据
+        size_t drop = std::min((size_t)-correction, reference_buffer_.size() - reference_read_pos_);
+        reference_buffer_.erase(reference_buffer_.begin() + reference_read_pos_,
+            reference_buffer_.begin() + reference_read_pos_ + drop);
+        correction = -(int)drop;
+    }
+    // 之后播放重新开始时也使用测量到的延迟
+    reference_delay_samples_ = std::max(0, reference_delay_samples_ + correction);
+    delay_estimator_.Reset();
+    ESP_LOGI(TAG, "Reference delay adjusted by %d samples to %d", correction, reference_delay_samples_);
+}
+
+void AudioCodec::EnableSoftwareReference() {
+    // 播放数据写入 I2S 后还要经过 DMA 缓冲才真正播放出来，参考信号按这个深度延迟
+    int dma_delay_samples = AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM * input_sample_rate_ / output_sample_rate_;
+    reference_delay_samples_ = dma_delay_samples + input_sample_rate_ * CONFIG_AUDIO_REFERENCE_EXTRA_DELAY_MS / 1000;
+    if (input_sample_rate_ != output_sample_rate_) {
+        reference_resampler_.Configure(output_sample_rate_, input_sample_rate_);
+    }
+    delay_estimator_.Configure(input_sample_rate_, REFERENCE_DELAY_SEARCH_MS);
+    software_reference_ = true;
+    ESP_LOGI(TAG, "Software reference enabled, delay %d samples", reference_delay_samples_);
+}
+
+void AudioCodec::PushReference(const std::vector<int16_t>& data) {
+    // 参考信号只需要单声道
+    std::vector<int16_t> mono;
+    if (output_channels_ > 1) {
+        mono.resize(data.size() / output_channels_);
+        for (size_t i = 0, j = 0; i < mono.size(); i++, j += output_channels_) {
+            mono[i] = data[j];
+        }
+    } else {
+        mono = data;
+    }
+    if (input_sample_rate_ != output_sample_rate_) {
+        std::vector<int16_t> resampled(reference_resampler_.GetOutputSamples(mono.size()));
+        reference_resampler_.Process(mono.data(), mono.size(), resampled.data());
+        mono = std::move(resampled);
+    }
+
+    std::lock_guard<std::mutex> lock(reference_mutex_);
+    if (reference_read_pos_ > 0) {
+        reference_buffer_.erase(reference_buffer_.begin(), reference_buffer_.begin() + reference_read_pos_);
+        reference_read_pos_ = 0;
+    }
+    if (reference_buffer_.empty()) {
+        // 播放重新开始，先补上 DMA 中尚未播放的时长，让参考信号与回声对齐
+        reference_buffer_.assign(reference_delay_samples_, 0);
+    }
+    reference_buffer_.insert(reference_buffer_.end(), mono.begin(), mono.end());
+
+    // 麦克风长时间没有读取时，只保留最近的数据
+    size_t max_samples = reference_delay_samples_ * 2 + input_sample_rate_ / 5;
+    if (reference_buffer_.size() > max_samples) {
+        reference_buffer_.erase(reference_buffer_.begin(), reference_buffer_.end() - max_samples);
     }
-    return false;
 }
 
 void AudioCodec::Start() {
@@ -34,6 +144,12 @@ void AudioCodec::Start() {
         output_volume_ = 10;
     }
 
+#if CONFIG_USE_REALTIME_CHAT
+    if (!input_reference_) {
+        EnableSoftwareReference();
+    }
+#endif
+
     ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
     ESP_ERROR_CHECK(i2s_channel_enable(rx_handle_));
 
@@ -48,6 +164,7 @@ void AudioCodec::SetOutputVolume(int volume) {
     
     Settings settings("audio", true);
     settings.SetInt("output_volume", output_volume_);
+    iot::ThingManager::GetInstance().NotifyPropertyChanged("Speaker", "volume");
 }
 
 void AudioCodec::EnableInput(bool enable) {
@@ -8,11 +8,16 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <mutex>
+
+#include <opus_resampler.h>
 
 #include "board.h"
+#include "reference_delay_estimator.h"
 
 #define AUDIO_CODEC_DMA_DESC_NUM 6
-#define AUDIO_CODEC_DMA_FRAME_NUM 240
+// Larger DMA blocks mean fewer interrupts but more latency, only raised for low power standby
+#define AUDIO_CODEC_DMA_FRAME_NUM CONFIG_AUDIO_CODEC_DMA_FRAME_NUM
 
 class AudioCodec {
 public:
@@ -28,10 +33,10 @@ public:
     bool InputData(std::vector<int16_t>& data);
 
     inline bool duplex() const { return duplex_; }
-    inline bool input_reference() const { return input_reference_; }
+    inline bool input_reference() const { return input_reference_ || software_reference_; }
     inline int input_sample_rate() const { return input_sample_rate_; }
     inline int output_sample_rate() const { return output_sample_rate_; }
-    inline int input_channels() const { return input_channels_; }
+    inline int input_channels() const { return input_channels_ + (software_reference_ ? 1 : 0); }
     inline int output_channels() const { return output_channels_; }
     inline int output_volume() const { return output_volume_; }
     inline bool input_enabled() const { return input_enabled_; }
@@ -53,6 +58,20 @@ protected:
 
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
+
+private:
+    // 软件回采：没有硬件参考通道的板子，用送进 I2S 的播放数据作为 AEC 参考信号
+    bool software_reference_ = false;
+    std::mutex reference_mutex_;
+    std::vector<int16_t> reference_buffer_;
+    size_t reference_read_pos_ = 0;
+    int reference_delay_samples_ = 0;
+    OpusResampler reference_resampler_;
+    ReferenceDelayEstimator delay_estimator_;
+
+    void EnableSoftwareReference();
+    void AdjustReferenceDelay(int correction);
+    void PushReference(const std::vector<int16_t>& data);
 };
 
 #endif // _AUDIO_CODEC_H
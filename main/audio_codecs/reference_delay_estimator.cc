@@ -0,0 +1,172 @@
+#include "reference_delay_estimator.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#define TAG "ReferenceDelay"
+
+// 互相关在降采样后的信号上计算，16kHz 时分辨率为 0.25ms
+#define ESTIMATOR_DECIMATION 4
+// 每次估计使用的窗口长度
+#define ESTIMATOR_WINDOW_MS 256
+// 参考信号平均幅度低于此值时（静音或音量很小）不做估计
+#define ESTIMATOR_MIN_LEVEL 200
+// 归一化相关峰值低于此值时认为不可靠
+#define ESTIMATOR_MIN_CORRELATION 0.3
+// 低于音频线程，只占用空闲的 CPU
+#define ESTIMATOR_TASK_PRIORITY 1
+
+ReferenceDelayEstimator::ReferenceDelayEstimator() {
+}
+
+ReferenceDelayEstimator::~ReferenceDelayEstimator() {
+    if (task_ != nullptr) {
+        vTaskDelete(task_);
+    }
+}
+
+void ReferenceDelayEstimator::Configure(int sample_rate, int max_lag_ms) {
+    decimation_ = ESTIMATOR_DECIMATION;
+    int rate = sample_rate / decimation_;
+    window_ = rate * ESTIMATOR_WINDOW_MS / 1000;
+    max_lag_ = rate * max_lag_ms / 1000;
+    mic_.reserve(window_ + 2 * max_lag_);
+    reference_.reserve(window_ + 2 * max_lag_);
+    work_mic_.reserve(window_ + 2 * max_lag_);
+    work_reference_.reserve(window_ + 2 * max_lag_);
+    Reset();
+
+    if (task_ == nullptr) {
+        xTaskCreate([](void* arg) {
+            static_cast<ReferenceDelayEstimator*>(arg)->EstimateTask();
+        }, "reference_delay", 3072, this, ESTIMATOR_TASK_PRIORITY, &task_);
+    }
+}
+
+void ReferenceDelayEstimator::Reset() {
+    mic_.clear();
+    reference_.clear();
+    mic_sum_ = 0;
+    reference_sum_ = 0;
+    decimation_count_ = 0;
+    generation_++;
+    correction_ = 0;
+}
+
+int ReferenceDelayEstimator::Process(const int16_t* mic, const int16_t* reference, size_t samples) {
+    if (window_ == 0 || task_ == nullptr) {
+        return 0;
+    }
+    for (size_t i = 0; i < samples; i++) {
+        // 取平均作为简单的低通滤波后降采样
+        mic_sum_ += mic[i];
+        reference_sum_ += reference[i];
+        if (++decimation_count_ < decimation_) {
+            continue;
+        }
+        mic_.push_back(mic_sum_ / decimation_);
+        reference_.push_back(reference_sum_ / decimation_);
+        mic_sum_ = 0;
+        reference_sum_ = 0;
+        decimation_count_ = 0;
+
+        if ((int)mic_.size() == window_ + 2 * max_lag_) {
+            // 后台任务还在计算上一个窗口时丢弃这个窗口
+            if (!busy_) {
+                std::swap(mic_, work_mic_);
+                std::swap(reference_, work_reference_);
+                work_generation_ = generation_;
+                busy_ = true;
+                xTaskNotifyGive(task_);
+            }
+            mic_.clear();
+            reference_.clear();
+        }
+    }
+    return correction_.exchange(0);
+}
+
+void ReferenceDelayEstimator::EstimateTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (work_generation_ != last_generation_) {
+            last_generation_ = work_generation_;
+            has_last_lag_ = false;
+        }
+
+        int lag = Estimate(work_mic_.data(), work_reference_.data());
+        if (lag != INT32_MIN) {
+            // 连续两次估计一致才修正，避免偶然的相关峰
+            if (has_last_lag_ && std::abs(lag - last_lag_) <= 1) {
+                has_last_lag_ = false;
+                if (work_generation_ == generation_) {
+                    correction_ = lag * decimation_;
+                }
+            } else {
+                has_last_lag_ = true;
+                last_lag_ = lag;
+            }
+        } else {
+            has_last_lag_ = false;
+        }
+        busy_ = false;
+    }
+}
+
+// 在 [-max_lag_, max_lag_] 范围内找 mic[n] 与 reference[n - lag] 的相关峰，
+// 没有可靠结果时返回 INT32_MIN
+int ReferenceDelayEstimator::Estimate(const int32_t* mic_data, const int32_t* reference_data) const {
+    int length = window_ + 2 * max_lag_;
+    int64_t reference_level = 0;
+    for (int n = 0; n < length; n++) {
+        reference_level += std::abs(reference_data[n]);
+    }
+    if (reference_level / length < ESTIMATOR_MIN_LEVEL) {
+        return INT32_MIN;
+    }
+
+    const int32_t* mic = mic_data + max_lag_;
+    double mic_energy = 0;
+    for (int n = 0; n < window_; n++) {
+        mic_energy += (double)mic[n] * mic[n];
+    }
+    if (mic_energy <= 0) {
+        return INT32_MIN;
+    }
+
+    // 参考信号窗口随 lag 每次左移一个采样，能量滑动更新
+    int64_t energy = 0;
+    const int32_t* first = reference_data + 2 * max_lag_;
+    for (int n = 0; n < window_; n++) {
+        energy += (int64_t)first[n] * first[n];
+    }
+
+    double best = 0;
+    int best_lag = 0;
+    for (int lag = -max_lag_; lag <= max_lag_; lag++) {
+        const int32_t* reference = reference_data + max_lag_ - lag;
+        if (lag > -max_lag_) {
+            energy += (int64_t)reference[0] * reference[0] - (int64_t)reference[window_] * reference[window_];
+        }
+        if (energy <= 0) {
+            continue;
+        }
+        int64_t sum = 0;
+        for (int n = 0; n < window_; n++) {
+            sum += (int64_t)mic[n] * reference[n];
+        }
+        // 扬声器极性可能相反，取绝对值
+        double correlation = std::fabs((double)sum) / std::sqrt(mic_energy * (double)energy);
+        if (correlation > best) {
+            best = correlation;
+            best_lag = lag;
+        }
+    }
+    if (best < ESTIMATOR_MIN_CORRELATION) {
+        return INT32_MIN;
+    }
+    ESP_LOGD(TAG, "Lag %d, correlation %.2f", best_lag * decimation_, best);
+    return best_lag;
+}
@@ -0,0 +1,57 @@
+#ifndef _REFERENCE_DELAY_ESTIMATOR_H
+#define _REFERENCE_DELAY_ESTIMATOR_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 软件回采的延迟估计：对麦克风与参考信号做互相关，测量回声相对参考信号的实际偏移，
+// 用于修正按 DMA 深度估算的初始延迟，以及播放中断、时钟漂移造成的错位。
+// 音频线程只做降采样和收集窗口，互相关在低优先级任务中计算，结果通过原子变量发布
+class ReferenceDelayEstimator {
+public:
+    ReferenceDelayEstimator();
+    ~ReferenceDelayEstimator();
+
+    // max_lag_ms 为当前对齐位置前后搜索的范围
+    void Configure(int sample_rate, int max_lag_ms);
+    void Reset();
+
+    // 输入已对齐的麦克风与参考信号（单声道），有可靠的估计时返回需要额外延迟参考信号的采样数，
+    // 正数表示参考信号超前于回声，负数表示滞后，否则返回 0
+    int Process(const int16_t* mic, const int16_t* reference, size_t samples);
+
+private:
+    int decimation_ = 4;
+    int window_ = 0;
+    int max_lag_ = 0;
+    std::vector<int32_t> mic_;
+    std::vector<int32_t> reference_;
+    int32_t mic_sum_ = 0;
+    int32_t reference_sum_ = 0;
+    int decimation_count_ = 0;
+
+    // 交给后台任务的窗口，busy_ 为 true 时只由后台任务访问
+    TaskHandle_t task_ = nullptr;
+    std::vector<int32_t> work_mic_;
+    std::vector<int32_t> work_reference_;
+    uint32_t work_generation_ = 0;
+    std::atomic<bool> busy_ = false;
+    // Reset 后递增，丢弃重置前的窗口算出的结果
+    std::atomic<uint32_t> generation_ = 0;
+    std::atomic<int> correction_ = 0;
+
+    // 只在后台任务中访问
+    uint32_t last_generation_ = 0;
+    int last_lag_ = 0;
+    bool has_last_lag_ = false;
+
+    void EstimateTask();
+    int Estimate(const int32_t* mic, const int32_t* reference) const;
+};
+
+#endif // _REFERENCE_DELAY_ESTIMATOR_H
@@ -0,0 +1,138 @@
+#include "audio_mixer.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "AudioMixer"
+
+static int GainToQ15(float gain) {
+    if (gain < 0.0f) {
+        gain = 0.0f;
+    } else if (gain > 1.0f) {
+        gain = 1.0f;
+    }
+    return static_cast<int>(gain * 32768);
+}
+
+AudioMixer::AudioMixer() {
+}
+
+AudioMixer::~AudioMixer() {
+}
+
+void AudioMixer::Initialize(int sample_rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sample_rate_ = sample_rate;
+}
+
+void AudioMixer::SetGain(AudioMixerChannel channel, float gain) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    channels_[channel].gain = GainToQ15(gain);
+}
+
+void AudioMixer::SetDucking(AudioMixerChannel target, AudioMixerChannel trigger, float gain, int hold_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    duck_target_ = target;
+    duck_trigger_ = trigger;
+    duck_gain_ = GainToQ15(gain);
+    duck_hold_samples_ = sample_rate_ * hold_ms / 1000;
+}
+
+size_t AudioMixer::AvailableLocked(const Channel& channel) const {
+    return channel.buffer.size() - channel.read_offset;
+}
+
+void AudioMixer::Write(AudioMixerChannel channel, const std::vector<int16_t>& pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& ch = channels_[channel];
+    // Drop the consumed samples before growing the buffer
+    if (ch.read_offset > 0) {
+        ch.buffer.erase(ch.buffer.begin(), ch.buffer.begin() + ch.read_offset);
+        ch.read_offset = 0;
+    }
+    ch.buffer.insert(ch.buffer.end(), pcm.begin(), pcm.end());
+}
+
+size_t AudioMixer::Available(AudioMixerChannel channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return AvailableLocked(channels_[channel]);
+}
+
+bool AudioMixer::IsEmpty() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& ch : channels_) {
+        if (AvailableLocked(ch) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AudioMixer::Clear(AudioMixerChannel channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& ch = channels_[channel];
+    ch.buffer.clear();
+    ch.read_offset = 0;
+}
+
+bool AudioMixer::Mix(std::vector<int16_t>& output) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Only mix as many samples as every active channel can provide, so that a channel
+    // waiting for its next frame does not get a gap of silence inserted
+    size_t samples = 0;
+    for (auto& ch : channels_) {
+        size_t available = AvailableLocked(ch);
+        if (available > 0 && (samples == 0 || available < samples)) {
+            samples = available;
+        }
+    }
+    if (samples == 0) {
+        return false;
+    }
+
+    if (duck_trigger_ >= 0 && AvailableLocked(channels_[duck_trigger_]) > 0) {
+        duck_remaining_samples_ = duck_hold_samples_;
+    }
+
+    std::vector<int32_t> accumulator(samples, 0);
+    for (int i = 0; i < kAudioMixerChannelCount; i++) {
+        auto& ch = channels_[i];
+        int target_gain = ch.gain;
+        if (i == duck_target_ && duck_remaining_samples_ > 0) {
+            target_gain = (int64_t)target_gain * duck_gain_ >> 15;
+        }
+
+        size_t available = AvailableLocked(ch);
+        if (available == 0) {
+            // Nothing to ramp over, jump to the target gain
+            ch.current_gain = target_gain;
+            continue;
+        }
+
+        // Ramp linearly from the current gain to the target gain over this block
+        const int16_t* src = ch.buffer.data() + ch.read_offset;
+        int64_t gain_step = ((int64_t)target_gain - ch.current_gain) * 65536 / (int64_t)samples;
+        int64_t gain = (int64_t)ch.current_gain * 65536;
+        for (size_t j = 0; j < samples; j++) {
+            gain += gain_step;
+            accumulator[j] += (int32_t)(((int64_t)src[j] * (gain >> 16)) >> 15);
+        }
+        ch.current_gain = target_gain;
+        ch.read_offset += samples;
+        if (ch.read_offset == ch.buffer.size()) {
+            ch.buffer.clear();
+            ch.read_offset = 0;
+        }
+    }
+
+    if (duck_remaining_samples_ > 0) {
+        duck_remaining_samples_ = std::max(0, duck_remaining_samples_ - (int)samples);
+    }
+
+    output.resize(samples);
+    for (size_t j = 0; j < samples; j++) {
+        output[j] = (int16_t)std::clamp(accumulator[j], (int32_t)INT16_MIN, (int32_t)INT16_MAX);
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+enum AudioMixerChannel {
+    kAudioMixerChannelVoice,
+    kAudioMixerChannelSound,
+    kAudioMixerChannelCount
+};
+
+// Mixes the PCM of several sources (server voice, local sounds) before it is handed to the codec.
+// All channels carry mono PCM at the codec output sample rate.
+class AudioMixer {
+public:
+    AudioMixer();
+    ~AudioMixer();
+
+    void Initialize(int sample_rate);
+    void SetGain(AudioMixerChannel channel, float gain);
+    // Lower the gain of the target channel while the trigger channel is playing
+    void SetDucking(AudioMixerChannel target, AudioMixerChannel trigger, float gain, int hold_ms = 300);
+    void Write(AudioMixerChannel channel, const std::vector<int16_t>& pcm);
+    size_t Available(AudioMixerChannel channel);
+    bool IsEmpty();
+    void Clear(AudioMixerChannel channel);
+    bool Mix(std::vector<int16_t>& output);
+
+private:
+    struct Channel {
+        std::vector<int16_t> buffer;
+        size_t read_offset = 0;
+        int gain = 32768;           // Q15
+        int current_gain = 32768;   // Q15, ramps towards the effective gain
+    };
+
+    std::mutex mutex_;
+    Channel channels_[kAudioMixerChannelCount];
+    int sample_rate_ = 16000;
+
+    int duck_target_ = -1;
+    int duck_trigger_ = -1;
+    int duck_gain_ = 32768;
+    int duck_hold_samples_ = 0;
+    int duck_remaining_samples_ = 0;
+
+    size_t AvailableLocked(const Channel& channel) const;
+};
+
+#endif // AUDIO_MIXER_H
@@ -8,6 +8,11 @@ static const char* TAG = "AudioProcessor";
 AudioProcessor::AudioProcessor()
     : afe_data_(nullptr) {
     event_group_ = xEventGroupCreate();
+
+    auto ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "audio_processor", &pm_lock_);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGE(TAG, "Failed to create power management lock: %s", esp_err_to_name(ret));
+    }
 }
 
 void AudioProcessor::Initialize(AudioCodec* codec, bool realtime_chat) {
@@ -61,6 +66,9 @@ AudioProcessor::~AudioProcessor() {
     if (afe_data_ != nullptr) {
         afe_iface_->destroy(afe_data_);
     }
+    if (pm_lock_ != nullptr) {
+        esp_pm_lock_delete(pm_lock_);
+    }
     vEventGroupDelete(event_group_);
 }
 
@@ -79,6 +87,9 @@ void AudioProcessor::Feed(const std::vector<int16_t>& data) {
 }
 
 void AudioProcessor::Start() {
+    if (pm_lock_ != nullptr && !pm_lock_held_.exchange(true)) {
+        esp_pm_lock_acquire(pm_lock_);
+    }
     xEventGroupSetBits(event_group_, PROCESSOR_RUNNING);
 }
 
@@ -87,6 +98,9 @@ void AudioProcessor::Stop() {
     if (afe_data_ != nullptr) {
         afe_iface_->reset_buffer(afe_data_);
     }
+    if (pm_lock_ != nullptr && pm_lock_held_.exchange(false)) {
+        esp_pm_lock_release(pm_lock_);
+    }
 }
 
 bool AudioProcessor::IsRunning() {
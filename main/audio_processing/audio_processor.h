@@ -2,6 +2,7 @@
 #define AUDIO_PROCESSOR_H
 
 #include <esp_afe_sr_models.h>
+#include <esp_pm.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
@@ -9,6 +10,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <atomic>
 
 #include "audio_codec.h"
 
@@ -34,6 +36,9 @@ private:
     std::function<void(bool speaking)> vad_state_change_callback_;
     AudioCodec* codec_ = nullptr;
     bool is_speaking_ = false;
+    // Keep the CPU at full speed while the AFE is running
+    esp_pm_lock_handle_t pm_lock_ = nullptr;
+    std::atomic<bool> pm_lock_held_ = false;
 
     void AudioProcessorTask();
 };
@@ -0,0 +1,81 @@
+#include "opus_decoder_pool.h"
+
+#include <esp_log.h>
+
+#define TAG "OpusDecoderPool"
+
+// Idle decoders kept for reuse, the rest are freed on release
+#define OPUS_DECODER_POOL_MAX_IDLE 3
+
+bool PooledOpusDecoder::Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm) {
+    if (!decoder->Decode(std::move(opus), pcm)) {
+        return false;
+    }
+    if (need_resample) {
+        std::vector<int16_t> resampled(resampler.GetOutputSamples(pcm.size()));
+        resampler.Process(pcm.data(), pcm.size(), resampled.data());
+        pcm = std::move(resampled);
+    }
+    return true;
+}
+
+OpusDecoderPool::OpusDecoderPool() {
+}
+
+OpusDecoderPool::~OpusDecoderPool() {
+}
+
+void OpusDecoderPool::Initialize(int output_sample_rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_sample_rate_ = output_sample_rate;
+}
+
+PooledOpusDecoder* OpusDecoderPool::Acquire(int sample_rate, int frame_duration) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& it : decoders_) {
+        if (!it.in_use && it.decoder->sample_rate() == sample_rate && it.decoder->duration_ms() == frame_duration) {
+            it.in_use = true;
+            it.decoder->ResetState();
+            if (it.need_resample) {
+                // Configure only clears the filter state, nothing is allocated
+                it.resampler.Configure(sample_rate, output_sample_rate_);
+            }
+            return &it;
+        }
+    }
+
+    ESP_LOGI(TAG, "Create decoder %dHz %dms", sample_rate, frame_duration);
+    auto& it = decoders_.emplace_back();
+    it.decoder = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    it.need_resample = sample_rate != output_sample_rate_;
+    if (it.need_resample) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d", sample_rate, output_sample_rate_);
+        it.resampler.Configure(sample_rate, output_sample_rate_);
+    }
+    it.in_use = true;
+    return &it;
+}
+
+void OpusDecoderPool::Release(PooledOpusDecoder* decoder) {
+    if (decoder == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    decoder->in_use = false;
+
+    int idle = 0;
+    for (auto& it : decoders_) {
+        if (!it.in_use) {
+            idle++;
+        }
+    }
+    if (idle > OPUS_DECODER_POOL_MAX_IDLE) {
+        // Free the oldest idle decoder other than the one just released
+        for (auto it = decoders_.begin(); it != decoders_.end(); ++it) {
+            if (!it->in_use && &(*it) != decoder) {
+                decoders_.erase(it);
+                break;
+            }
+        }
+    }
+}
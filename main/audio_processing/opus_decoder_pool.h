@@ -0,0 +1,41 @@
+#ifndef OPUS_DECODER_POOL_H
+#define OPUS_DECODER_POOL_H
+
+#include <opus_decoder.h>
+#include <opus_resampler.h>
+
+#include <list>
+#include <mutex>
+#include <memory>
+
+// A decoder with the resampler that converts its output to the codec output sample rate
+struct PooledOpusDecoder {
+    std::unique_ptr<OpusDecoderWrapper> decoder;
+    OpusResampler resampler;
+    bool need_resample = false;
+    bool in_use = false;
+
+    // Decode a packet and resample it to the output sample rate
+    bool Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm);
+};
+
+// Keeps the Opus decoders alive between uses.
+// Switching between sample rates / frame durations only resets the decoder state
+// instead of freeing and allocating a new decoder.
+class OpusDecoderPool {
+public:
+    OpusDecoderPool();
+    ~OpusDecoderPool();
+
+    void Initialize(int output_sample_rate);
+    // Get a decoder for exclusive use, the state is reset
+    PooledOpusDecoder* Acquire(int sample_rate, int frame_duration);
+    void Release(PooledOpusDecoder* decoder);
+
+private:
+    std::mutex mutex_;
+    std::list<PooledOpusDecoder> decoders_;
+    int output_sample_rate_ = 16000;
+};
+
+#endif // OPUS_DECODER_POOL_H
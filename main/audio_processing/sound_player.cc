@@ -0,0 +1,149 @@
+#include "sound_player.h"
+#include "protocol.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <arpa/inet.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "SoundPlayer"
+
+// Upper bound of PSRAM used by decoded sounds
+#define SOUND_CACHE_MAX_BYTES (256 * 1024)
+
+SoundPlayer::SoundPlayer() {
+}
+
+SoundPlayer::~SoundPlayer() {
+    if (decoder_pool_ != nullptr) {
+        decoder_pool_->Release(opus_decoder_);
+    }
+    for (auto& it : cache_) {
+        heap_caps_free(it.second.data);
+    }
+}
+
+void SoundPlayer::Initialize(OpusDecoderPool* decoder_pool, int output_sample_rate) {
+    decoder_pool_ = decoder_pool;
+    output_sample_rate_ = output_sample_rate;
+    opus_decoder_ = decoder_pool_->Acquire(SOUND_SAMPLE_RATE, SOUND_FRAME_DURATION_MS);
+}
+
+bool SoundPlayer::NextFrame(Clip& clip, const uint8_t*& payload, size_t& payload_size) {
+    if (clip.offset + sizeof(BinaryProtocol3) > clip.data.size()) {
+        return false;
+    }
+    auto p3 = (const BinaryProtocol3*)(clip.data.data() + clip.offset);
+    payload_size = ntohs(p3->payload_size);
+    if (clip.offset + sizeof(BinaryProtocol3) + payload_size > clip.data.size()) {
+        ESP_LOGE(TAG, "Truncated P3 frame at offset %u", (unsigned)clip.offset);
+        return false;
+    }
+    payload = p3->payload;
+    clip.offset += sizeof(BinaryProtocol3) + payload_size;
+    return true;
+}
+
+void SoundPlayer::Play(const std::string_view& sound) {
+    Clip clip;
+    clip.data = sound;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cache_.find(sound.data());
+    if (it != cache_.end()) {
+        clip.pcm = it->second.data;
+        clip.pcm_size = it->second.size;
+    }
+    clips_.emplace_back(clip);
+}
+
+void SoundPlayer::Preload(const std::string_view& sound) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cache_.find(sound.data()) != cache_.end()) {
+            return;
+        }
+    }
+
+    // Decode with another decoder so that the playback state is not disturbed
+    auto decoder = decoder_pool_->Acquire(SOUND_SAMPLE_RATE, SOUND_FRAME_DURATION_MS);
+
+    std::vector<int16_t> samples;
+    Clip clip;
+    clip.data = sound;
+    const uint8_t* payload;
+    size_t payload_size;
+    while (NextFrame(clip, payload, payload_size)) {
+        std::vector<int16_t> pcm;
+        if (!decoder->Decode(std::vector<uint8_t>(payload, payload + payload_size), pcm)) {
+            continue;
+        }
+        samples.insert(samples.end(), pcm.begin(), pcm.end());
+    }
+    decoder_pool_->Release(decoder);
+
+    size_t bytes = samples.size() * sizeof(int16_t);
+    if (bytes == 0 || cache_bytes_ + bytes > SOUND_CACHE_MAX_BYTES) {
+        ESP_LOGW(TAG, "Skip caching sound of %u bytes, cache used %u bytes", (unsigned)bytes, (unsigned)cache_bytes_);
+        return;
+    }
+    auto data = (int16_t*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        ESP_LOGW(TAG, "Failed to allocate %u bytes in PSRAM for sound cache", (unsigned)bytes);
+        return;
+    }
+    memcpy(data, samples.data(), bytes);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_[sound.data()] = CachedPcm{data, samples.size()};
+    cache_bytes_ += bytes;
+    ESP_LOGI(TAG, "Cached sound of %u samples, cache used %u bytes", (unsigned)samples.size(), (unsigned)cache_bytes_);
+}
+
+void SoundPlayer::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clips_.clear();
+}
+
+bool SoundPlayer::IsPlaying() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !clips_.empty();
+}
+
+// Must be called from a single task, the decoder state is not protected by the mutex
+bool SoundPlayer::Read(std::vector<int16_t>& pcm) {
+    const uint8_t* payload = nullptr;
+    size_t payload_size = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!clips_.empty()) {
+            auto& clip = clips_.front();
+            if (clip.pcm != nullptr) {
+                // Cached sounds are already at the output sample rate
+                size_t frame_samples = output_sample_rate_ * SOUND_FRAME_DURATION_MS / 1000;
+                size_t samples = std::min(frame_samples, clip.pcm_size - clip.offset);
+                pcm.assign(clip.pcm + clip.offset, clip.pcm + clip.offset + samples);
+                clip.offset += samples;
+                if (clip.offset >= clip.pcm_size) {
+                    clips_.pop_front();
+                }
+                return true;
+            }
+
+            bool has_frame = NextFrame(clip, payload, payload_size);
+            if (!has_frame || clip.offset >= clip.data.size()) {
+                clips_.pop_front();
+            }
+            if (has_frame) {
+                break;
+            }
+        }
+    }
+    if (payload == nullptr) {
+        return false;
+    }
+
+    // The payload points to flash, only the frame being decoded is copied
+    return opus_decoder_->Decode(std::vector<uint8_t>(payload, payload + payload_size), pcm);
+}
@@ -0,0 +1,56 @@
+#ifndef SOUND_PLAYER_H
+#define SOUND_PLAYER_H
+
+#include "opus_decoder_pool.h"
+
+#include <string_view>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// The local P3 assets are encoded at 16000Hz, 60ms frame duration
+#define SOUND_SAMPLE_RATE 16000
+#define SOUND_FRAME_DURATION_MS 60
+
+// Plays the P3 sounds embedded in flash.
+// Clips are queued as views of the flash data and played back to back through
+// a dedicated decoder, so the decoder used for server audio is never touched.
+class SoundPlayer {
+public:
+    SoundPlayer();
+    ~SoundPlayer();
+
+    void Initialize(OpusDecoderPool* decoder_pool, int output_sample_rate);
+    void Play(const std::string_view& sound);
+    void Preload(const std::string_view& sound);
+    void Clear();
+    bool IsPlaying();
+    // Decode the next frame of the queued clips, resampled to the output sample rate
+    bool Read(std::vector<int16_t>& pcm);
+
+private:
+    struct Clip {
+        std::string_view data;
+        size_t offset = 0;
+        const int16_t* pcm = nullptr;
+        size_t pcm_size = 0;
+    };
+    struct CachedPcm {
+        int16_t* data;
+        size_t size;
+    };
+
+    std::mutex mutex_;
+    std::deque<Clip> clips_;
+    std::map<const char*, CachedPcm> cache_;
+    size_t cache_bytes_ = 0;
+    int output_sample_rate_ = SOUND_SAMPLE_RATE;
+
+    OpusDecoderPool* decoder_pool_ = nullptr;
+    PooledOpusDecoder* opus_decoder_ = nullptr;
+
+    bool NextFrame(Clip& clip, const uint8_t*& payload, size_t& payload_size);
+};
+
+#endif // SOUND_PLAYER_H
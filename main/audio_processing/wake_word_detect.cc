@@ -5,6 +5,8 @@
 #include <model_path.h>
 #include <arpa/inet.h>
 #include <sstream>
+#include <cstdlib>
+#include <algorithm>
 
 #define DETECTION_RUNNING_EVENT 1
 
@@ -16,6 +18,11 @@ WakeWordDetect::WakeWordDetect()
       wake_word_opus_() {
 
     event_group_ = xEventGroupCreate();
+
+    auto ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "wake_word", &pm_lock_);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGE(TAG, "Failed to create power management lock: %s", esp_err_to_name(ret));
+    }
 }
 
 WakeWordDetect::~WakeWordDetect() {
@@ -27,6 +34,9 @@ WakeWordDetect::~WakeWordDetect() {
         heap_caps_free(wake_word_encode_task_stack_);
     }
 
+    if (pm_lock_ != nullptr) {
+        esp_pm_lock_delete(pm_lock_);
+    }
     vEventGroupDelete(event_group_);
 }
 
@@ -65,6 +75,7 @@ void WakeWordDetect::Initialize(AudioCodec* codec) {
     
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
+    feed_chunk_size_ = afe_iface_->get_feed_chunksize(afe_data_);
 
     xTaskCreate([](void* arg) {
         auto this_ = (WakeWordDetect*)arg;
@@ -86,6 +97,9 @@ void WakeWordDetect::StopDetection() {
     if (afe_data_ != nullptr) {
         afe_iface_->reset_buffer(afe_data_);
     }
+    pending_samples_ = 0;
+    ReleasePowerLock();
+    reset_gate_ = true;
 }
 
 bool WakeWordDetect::IsDetectionRunning() {
@@ -96,7 +110,87 @@ void WakeWordDetect::Feed(const std::vector<int16_t>& data) {
     if (afe_data_ == nullptr) {
         return;
     }
+    frames_total_++;
+    // The gate state is only touched by the audio loop, drop the audio from before the detection stopped
+    if (reset_gate_.exchange(false)) {
+        pre_roll_.clear();
+        gate_hold_frames_ = 0;
+    }
+#if CONFIG_USE_WAKE_WORD_ENERGY_GATE
+    if (!PassEnergyGate(data)) {
+        // Audio fed before the gate closed is released by the detection task once fetched
+        if (pending_samples_ == 0) {
+            ReleasePowerLock();
+        }
+        return;
+    }
+#endif
+    AcquirePowerLock();
+    // Feed the pre-roll first so WakeNet gets the audio in order
+    while (!pre_roll_.empty()) {
+        pending_samples_ += feed_chunk_size_;
+        afe_iface_->feed(afe_data_, pre_roll_.front().data());
+        pre_roll_.pop_front();
+    }
+    pending_samples_ += feed_chunk_size_;
     afe_iface_->feed(afe_data_, data.data());
+    frames_fed_++;
+}
+
+#if CONFIG_USE_WAKE_WORD_ENERGY_GATE
+// Cheap check of the mic level, runs for every frame in the audio loop
+bool WakeWordDetect::PassEnergyGate(const std::vector<int16_t>& data) {
+    int channels = codec_->input_channels();
+    int64_t sum = 0;
+    size_t samples = data.size() / channels;
+    for (size_t i = 0; i < data.size(); i += channels) {
+        sum += std::abs(data[i]);
+    }
+    int level = samples > 0 ? sum / samples : 0;
+
+    // The noise floor follows drops at once and rises slowly
+    if (noise_floor_ == 0 || level < noise_floor_) {
+        noise_floor_ = level;
+    } else {
+        noise_floor_ += (level - noise_floor_) / 64;
+    }
+
+    int frame_ms = samples * 1000 / 16000;
+    if (frame_ms <= 0) {
+        return true;
+    }
+    if (level >= CONFIG_WAKE_WORD_ENERGY_GATE_MIN_LEVEL && level > noise_floor_ * CONFIG_WAKE_WORD_ENERGY_GATE_RATIO) {
+        gate_hold_frames_ = CONFIG_WAKE_WORD_ENERGY_GATE_HOLD_MS / frame_ms;
+    }
+    if (gate_hold_frames_ > 0) {
+        gate_hold_frames_--;
+        return true;
+    }
+
+    pre_roll_.push_back(data);
+    while (pre_roll_.size() > (size_t)(CONFIG_WAKE_WORD_ENERGY_GATE_PRE_ROLL_MS / frame_ms)) {
+        pre_roll_.pop_front();
+    }
+    return false;
+}
+#endif
+
+void WakeWordDetect::AcquirePowerLock() {
+    if (pm_lock_ != nullptr && !pm_lock_held_.exchange(true)) {
+        esp_pm_lock_acquire(pm_lock_);
+    }
+}
+
+void WakeWordDetect::ReleasePowerLock() {
+    if (pm_lock_ != nullptr && pm_lock_held_.exchange(false)) {
+        esp_pm_lock_release(pm_lock_);
+    }
+}
+
+int WakeWordDetect::GetFedPercent() {
+    uint32_t total = frames_total_.exchange(0);
+    uint32_t fed = frames_fed_.exchange(0);
+    return total > 0 ? fed * 100 / total : 0;
 }
 
 size_t WakeWordDetect::GetFeedSize() {
@@ -116,7 +210,21 @@ void WakeWordDetect::AudioDetectionTask() {
         xEventGroupWaitBits(event_group_, DETECTION_RUNNING_EVENT, pdFALSE, pdTRUE, portMAX_DELAY);
 
         auto res = afe_iface_->fetch_with_delay(afe_data_, portMAX_DELAY);
-        if (res == nullptr || res->ret_value == ESP_FAIL) {
+        if (res == nullptr) {
+            continue;
+        }
+        // Scale down only once all the fed audio is processed, the next feed raises the CPU frequency again
+        int pending = pending_samples_.load();
+        while (!pending_samples_.compare_exchange_weak(pending, std::max(pending - fetch_size, 0))) {
+        }
+        if (pending <= fetch_size) {
+            ReleasePowerLock();
+            // A feed may have come in between
+            if (pending_samples_ > 0) {
+                AcquirePowerLock();
+            }
+        }
+        if (res->ret_value == ESP_FAIL) {
             continue;;
         }
 
@@ -7,12 +7,15 @@
 
 #include <esp_afe_sr_models.h>
 #include <esp_nsn_models.h>
+#include <esp_pm.h>
 
 #include <list>
 #include <string>
 #include <vector>
 #include <functional>
 #include <mutex>
+#include <atomic>
+#include <deque>
 #include <condition_variable>
 
 #include "audio_codec.h"
@@ -32,6 +35,8 @@ public:
     void EncodeWakeWordData();
     bool GetWakeWordOpus(std::vector<uint8_t>& opus);
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
+    // Percentage of the audio passed to WakeNet since the last call
+    int GetFedPercent();
 
 private:
     esp_afe_sr_iface_t* afe_iface_ = nullptr;
@@ -51,6 +56,25 @@ private:
     std::mutex wake_word_mutex_;
     std::condition_variable wake_word_cv_;
 
+    // The CPU runs at full speed from a feed until WakeNet has processed all the fed audio,
+    // and scales down in between
+    esp_pm_lock_handle_t pm_lock_ = nullptr;
+    std::atomic<bool> pm_lock_held_ = false;
+    // Samples per channel fed to the AFE and not fetched yet
+    std::atomic<int> pending_samples_ = 0;
+    int feed_chunk_size_ = 0;
+    std::atomic<uint32_t> frames_total_ = 0;
+    std::atomic<uint32_t> frames_fed_ = 0;
+
+    // Energy gate, quiet audio is kept as pre-roll instead of being fed to WakeNet
+    std::deque<std::vector<int16_t>> pre_roll_;
+    int noise_floor_ = 0;
+    int gate_hold_frames_ = 0;
+    std::atomic<bool> reset_gate_ = false;
+
+    bool PassEnergyGate(const std::vector<int16_t>& data);
+    void AcquirePowerLock();
+    void ReleasePowerLock();
     void StoreWakeWordData(uint16_t* data, size_t size);
     void AudioDetectionTask();
 };
@@ -1,5 +1,6 @@
 #include "backlight.h"
 #include "settings.h"
+#include "iot/thing_manager.h"
 
 #include <esp_log.h>
 #include <driver/ledc.h>
@@ -78,6 +79,7 @@ void Backlight::OnTransitionTimer() {
 
     if (brightness_ == target_brightness_) {
         esp_timer_stop(transition_timer_);
+        iot::ThingManager::GetInstance().NotifyPropertyChanged("Screen", "brightness");
     }
 }
 
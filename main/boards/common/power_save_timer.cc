@@ -1,5 +1,6 @@
 #include "power_save_timer.h"
 #include "application.h"
+#include "settings.h"
 
 #include <esp_log.h>
 
@@ -63,6 +64,7 @@ void PowerSaveTimer::PowerSaveCheck() {
     if (seconds_to_sleep_ != -1 && ticks_ >= seconds_to_sleep_) {
         if (!in_sleep_mode_) {
             in_sleep_mode_ = true;
+            Settings::Flush();
             if (on_enter_sleep_mode_) {
                 on_enter_sleep_mode_();
             }
@@ -78,6 +80,7 @@ void PowerSaveTimer::PowerSaveCheck() {
         }
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        Settings::Flush();
         on_shutdown_request_();
     }
 }
@@ -16,6 +16,7 @@
 #include <tls_transport.h>
 #include <web_socket.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include <wifi_station.h>
 #include <wifi_configuration_ap.h>
@@ -80,8 +81,16 @@ void WifiBoard::StartNetwork() {
         return;
     }
 
+    // Connect to the access point of the last connection before WifiStation starts scanning
+    bool fast_connect_prepared = fast_connect_.Prepare();
+    int64_t start_time = esp_timer_get_time();
+
     auto& wifi_station = WifiStation::GetInstance();
     wifi_station.OnScanBegin([this]() {
+        // The scan of WifiStation is refused while the fast connection is in progress
+        if (fast_connect_.active()) {
+            return;
+        }
         auto display = Board::GetInstance().GetDisplay();
         display->ShowNotification(Lang::Strings::SCANNING_WIFI, 30000);
     });
@@ -95,18 +104,35 @@ void WifiBoard::StartNetwork() {
     wifi_station.OnConnected([this](const std::string& ssid) {
         auto display = Board::GetInstance().GetDisplay();
         std::string notification = Lang::Strings::CONNECTED_TO;
-        notification += ssid;
+        notification += ssid.empty() ? fast_connect_.ssid() : ssid;
         display->ShowNotification(notification.c_str(), 30000);
     });
     wifi_station.Start();
 
     // Try to connect to WiFi, if failed, launch the WiFi configuration AP
     if (!wifi_station.WaitForConnected(60 * 1000)) {
+        fast_connect_.Stop();
         wifi_station.Stop();
         wifi_config_mode_ = true;
         EnterWifiConfigMode();
         return;
     }
+    fast_connect_.Stop();
+
+    std::string ssid = GetSsid();
+    connect_time_ms_ = (esp_timer_get_time() - start_time) / 1000;
+    connect_method_ = fast_connect_.connected() ? "fast" : (fast_connect_prepared ? "fast_fallback" : "scan");
+    ESP_LOGI(TAG, "WiFi connected to %s in %lld ms (%s)", ssid.c_str(), connect_time_ms_, connect_method_);
+    fast_connect_.Save(ssid);
+}
+
+// A directed connection does not go through the scan, WifiStation does not know the SSID
+std::string WifiBoard::GetSsid() {
+    auto& wifi_station = WifiStation::GetInstance();
+    if (fast_connect_.connected() && wifi_station.GetSsid().empty()) {
+        return fast_connect_.ssid();
+    }
+    return wifi_station.GetSsid();
 }
 
 Http* WifiBoard::CreateHttp() {
@@ -157,10 +183,14 @@ std::string WifiBoard::GetBoardJson() {
     std::string board_json = std::string("{\"type\":\"" BOARD_TYPE "\",");
     board_json += "\"name\":\"" BOARD_NAME "\",";
     if (!wifi_config_mode_) {
-        board_json += "\"ssid\":\"" + wifi_station.GetSsid() + "\",";
+        board_json += "\"ssid\":\"" + GetSsid() + "\",";
         board_json += "\"rssi\":" + std::to_string(wifi_station.GetRssi()) + ",";
         board_json += "\"channel\":" + std::to_string(wifi_station.GetChannel()) + ",";
         board_json += "\"ip\":\"" + wifi_station.GetIpAddress() + "\",";
+        if (connect_time_ms_ >= 0) {
+            board_json += "\"connect_ms\":" + std::to_string(connect_time_ms_) + ",";
+            board_json += "\"connect_method\":\"" + std::string(connect_method_) + "\",";
+        }
     }
     board_json += "\"mac\":\"" + SystemInfo::GetMacAddress() + "\"}";
     return board_json;
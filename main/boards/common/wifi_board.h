@@ -2,13 +2,19 @@
 #define WIFI_BOARD_H
 
 #include "board.h"
+#include "wifi_fast_connect.h"
 
 class WifiBoard : public Board {
 protected:
     bool wifi_config_mode_ = false;
+    WifiFastConnect fast_connect_;
+    // Time from the start of the station to the connection, reported in the board JSON
+    int64_t connect_time_ms_ = -1;
+    const char* connect_method_ = "scan";
 
     WifiBoard();
     void EnterWifiConfigMode();
+    std::string GetSsid();
     virtual std::string GetBoardJson() override;
 
 public:
@@ -0,0 +1,265 @@
+#include "wifi_fast_connect.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mbedtls/pkcs5.h>
+#include <ssid_manager.h>
+
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#define TAG "WifiFastConnect"
+
+// Give up the directed connection and scan after this time
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 5000
+// NVS namespace of the cached access points, the "wifi" namespace belongs to SsidManager
+#define WIFI_FAST_CONNECT_NAMESPACE "wifi_fast"
+
+WifiFastConnect::WifiFastConnect() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<WifiFastConnect*>(arg);
+            if (self->attempting_) {
+                self->Fallback("timeout");
+            }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifi_fast_connect",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timeout_timer_));
+}
+
+WifiFastConnect::~WifiFastConnect() {
+    Stop();
+    if (timeout_timer_ != nullptr) {
+        esp_timer_delete(timeout_timer_);
+    }
+}
+
+// NVS keys are limited to 15 characters, the SSID is hashed (FNV-1a)
+std::string WifiFastConnect::GetKey(const std::string& ssid) {
+    uint32_t hash = 2166136261u;
+    for (char c : ssid) {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    char key[16];
+    snprintf(key, sizeof(key), "ap_%08lx", (unsigned long)hash);
+    return key;
+}
+
+// WPA2-PSK PMK, saves the 4096 rounds of PBKDF2 in the driver on every connection
+std::string WifiFastConnect::DerivePmk(const std::string& ssid, const std::string& password) {
+    uint8_t pmk[32];
+    int ret = mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1, (const uint8_t*)password.data(), password.size(),
+        (const uint8_t*)ssid.data(), ssid.size(), 4096, sizeof(pmk), pmk);
+    if (ret != 0) {
+        return "";
+    }
+    char hex[sizeof(pmk) * 2 + 1];
+    for (size_t i = 0; i < sizeof(pmk); i++) {
+        snprintf(hex + i * 2, 3, "%02x", pmk[i]);
+    }
+    return hex;
+}
+
+bool WifiFastConnect::Prepare() {
+    Settings settings(WIFI_FAST_CONNECT_NAMESPACE, false);
+    auto& ssid_list = SsidManager::GetInstance().GetSsidList();
+    for (auto& item : ssid_list) {
+        // Value: bssid,channel,authmode[,pmk]
+        std::string value = settings.GetString(GetKey(item.ssid));
+        if (value.empty()) {
+            continue;
+        }
+        unsigned int bssid[6], channel, authmode;
+        char pmk[65] = {0};
+        int fields = sscanf(value.c_str(), "%02x%02x%02x%02x%02x%02x,%u,%u,%64s",
+            &bssid[0], &bssid[1], &bssid[2], &bssid[3], &bssid[4], &bssid[5], &channel, &authmode, pmk);
+        if (fields < 8) {
+            continue;
+        }
+        for (int i = 0; i < 6; i++) {
+            bssid_[i] = bssid[i];
+        }
+        channel_ = channel;
+        authmode_ = (wifi_auth_mode_t)authmode;
+        pmk_ = fields == 9 ? pmk : "";
+        ssid_ = item.ssid;
+        password_ = item.password;
+        break;
+    }
+    if (ssid_.empty()) {
+        return false;
+    }
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, [](void* arg, esp_event_base_t base, int32_t id, void* data) {
+        static_cast<WifiFastConnect*>(arg)->OnWifiEvent(id);
+    }, this, &wifi_event_instance_));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, [](void* arg, esp_event_base_t base, int32_t id, void* data) {
+        static_cast<WifiFastConnect*>(arg)->OnGotIp();
+    }, this, &ip_event_instance_));
+    ESP_LOGI(TAG, "Cached access point for %s on channel %u", ssid_.c_str(), channel_);
+    return true;
+}
+
+void WifiFastConnect::Stop() {
+    attempting_ = false;
+    if (timeout_timer_ != nullptr) {
+        esp_timer_stop(timeout_timer_);
+    }
+    if (wifi_event_instance_ != nullptr) {
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_instance_);
+        wifi_event_instance_ = nullptr;
+    }
+    if (ip_event_instance_ != nullptr) {
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, ip_event_instance_);
+        ip_event_instance_ = nullptr;
+    }
+}
+
+// The handler is registered before WifiStation, so the connection is started before its scan,
+// which is refused by the driver while connecting
+void WifiFastConnect::OnWifiEvent(int32_t event_id) {
+    if (event_id == WIFI_EVENT_STA_START) {
+        Connect();
+    } else if (event_id == WIFI_EVENT_STA_DISCONNECTED && attempting_) {
+        Fallback("disconnected");
+    }
+}
+
+void WifiFastConnect::Connect() {
+    wifi_config_t config = {};
+    strncpy((char*)config.sta.ssid, ssid_.c_str(), sizeof(config.sta.ssid));
+    // A 64 digit hex password is taken as the PSK, only valid for WPA/WPA2 personal
+    bool use_pmk = !pmk_.empty() && (authmode_ == WIFI_AUTH_WPA_PSK || authmode_ == WIFI_AUTH_WPA2_PSK ||
+        authmode_ == WIFI_AUTH_WPA_WPA2_PSK);
+    const std::string& password = use_pmk ? pmk_ : password_;
+    memcpy(config.sta.password, password.c_str(), std::min(password.size(), sizeof(config.sta.password)));
+    config.sta.channel = channel_;
+    config.sta.bssid_set = true;
+    memcpy(config.sta.bssid, bssid_, sizeof(bssid_));
+    config.sta.scan_method = WIFI_FAST_SCAN;
+
+    start_time_ = esp_timer_get_time();
+    attempting_ = true;
+    if (esp_wifi_set_config(WIFI_IF_STA, &config) != ESP_OK || esp_wifi_connect() != ESP_OK) {
+        Fallback("connect error");
+        return;
+    }
+    esp_timer_start_once(timeout_timer_, WIFI_FAST_CONNECT_TIMEOUT_MS * 1000);
+    ESP_LOGI(TAG, "Connecting to %s on channel %u%s", ssid_.c_str(), channel_, use_pmk ? " with cached PMK" : "");
+}
+
+void WifiFastConnect::Fallback(const char* reason) {
+    attempting_ = false;
+    esp_timer_stop(timeout_timer_);
+    ESP_LOGW(TAG, "Fast connect to %s failed (%s) after %lld ms, scanning",
+        ssid_.c_str(), reason, (esp_timer_get_time() - start_time_) / 1000);
+
+    // The access point may have moved, the next successful connection caches it again
+    Settings settings(WIFI_FAST_CONNECT_NAMESPACE, true);
+    settings.EraseKey(GetKey(ssid_));
+
+    esp_wifi_disconnect();
+    // Drop the cached access point from the driver, WifiStation connects to what the scan finds
+    wifi_config_t config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK) {
+        config.sta.bssid_set = false;
+        memset(config.sta.bssid, 0, sizeof(config.sta.bssid));
+        config.sta.channel = 0;
+        config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_wifi_set_config(WIFI_IF_STA, &config);
+    }
+    esp_wifi_scan_start(nullptr, false);
+}
+
+void WifiFastConnect::OnGotIp() {
+    if (!attempting_) {
+        return;
+    }
+    attempting_ = false;
+    connected_ = true;
+    esp_timer_stop(timeout_timer_);
+    ESP_LOGI(TAG, "Fast connect to %s in %lld ms", ssid_.c_str(), (esp_timer_get_time() - start_time_) / 1000);
+}
+
+void WifiFastConnect::Save(const std::string& ssid) {
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return;
+    }
+
+    std::string password;
+    for (auto& item : SsidManager::GetInstance().GetSsidList()) {
+        if (item.ssid == ssid) {
+            password = item.password;
+            break;
+        }
+    }
+
+    Settings settings(WIFI_FAST_CONNECT_NAMESPACE, true);
+    std::string key = GetKey(ssid);
+    std::string old_value = settings.GetString(key);
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%02x%02x%02x%02x%02x%02x,%u,%u",
+        ap_info.bssid[0], ap_info.bssid[1], ap_info.bssid[2], ap_info.bssid[3], ap_info.bssid[4], ap_info.bssid[5],
+        ap_info.primary, (unsigned)ap_info.authmode);
+    if (old_value.compare(0, strlen(prefix), prefix) == 0) {
+        return;
+    }
+
+    std::string value = prefix;
+    bool derive_pmk = false;
+    if (!password.empty() && (ap_info.authmode == WIFI_AUTH_WPA_PSK || ap_info.authmode == WIFI_AUTH_WPA2_PSK ||
+        ap_info.authmode == WIFI_AUTH_WPA_WPA2_PSK)) {
+        // Reuse the PMK if only the BSSID or channel changed, it depends on the SSID and password
+        size_t pmk_pos = old_value.rfind(',');
+        if (ssid == ssid_ && old_value.size() > 64 && pmk_pos != std::string::npos && old_value.size() - pmk_pos == 65) {
+            value += old_value.substr(pmk_pos);
+        } else {
+            derive_pmk = true;
+        }
+    }
+    // Without the PMK the next fast connection still skips the scan, the driver derives it
+    settings.SetString(key, value);
+    ESP_LOGI(TAG, "Cached access point for %s on channel %u", ssid.c_str(), ap_info.primary);
+    if (derive_pmk) {
+        SavePmkLater(ssid, password, value);
+    }
+}
+
+// The 4096 rounds of PBKDF2 take a few hundred ms of CPU, they run below the
+// audio and network tasks once the device is connected
+void WifiFastConnect::SavePmkLater(const std::string& ssid, const std::string& password, const std::string& value) {
+    struct PmkRequest {
+        std::string ssid;
+        std::string password;
+        std::string value;
+    };
+    auto request = new PmkRequest{ssid, password, value};
+    auto ret = xTaskCreate([](void* arg) {
+        auto request = static_cast<PmkRequest*>(arg);
+        std::string pmk = DerivePmk(request->ssid, request->password);
+        Settings settings(WIFI_FAST_CONNECT_NAMESPACE, true);
+        std::string key = GetKey(request->ssid);
+        // Skip it if the access point was dropped or replaced meanwhile
+        if (!pmk.empty() && settings.GetString(key) == request->value) {
+            settings.SetString(key, request->value + "," + pmk);
+            ESP_LOGI(TAG, "Cached PMK for %s", request->ssid.c_str());
+        }
+        delete request;
+        vTaskDelete(NULL);
+    }, "wifi_pmk", 4096, request, tskIDLE_PRIORITY + 1, nullptr);
+    if (ret != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create the PMK task");
+        delete request;
+    }
+}
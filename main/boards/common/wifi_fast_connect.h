@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include <esp_event.h>
+#include <esp_timer.h>
+#include <esp_wifi_types.h>
+
+// Connects directly to the access point of the last connection, skipping the scan of WifiStation.
+// The BSSID, channel, auth mode and PMK are cached per SSID in the "wifi_fast" settings namespace,
+// apart from the "wifi" namespace of SsidManager.
+// If the directed connection fails, a normal scan is started and WifiStation takes over.
+class WifiFastConnect {
+public:
+    WifiFastConnect();
+    ~WifiFastConnect();
+
+    // Load the cached access point of the first SSID that has one, must be called before WifiStation::Start
+    bool Prepare();
+    // Save the access point of the current connection, the PMK is derived later on a low priority task
+    void Save(const std::string& ssid);
+    // Stop handling WiFi events, later reconnections are left to WifiStation
+    void Stop();
+
+    inline bool active() const { return attempting_ || connected_; }
+    inline bool connected() const { return connected_; }
+    inline const std::string& ssid() const { return ssid_; }
+
+private:
+    std::string ssid_;
+    std::string password_;
+    uint8_t bssid_[6] = {0};
+    uint8_t channel_ = 0;
+    wifi_auth_mode_t authmode_ = WIFI_AUTH_OPEN;
+    std::string pmk_;
+
+    esp_event_handler_instance_t wifi_event_instance_ = nullptr;
+    esp_event_handler_instance_t ip_event_instance_ = nullptr;
+    esp_timer_handle_t timeout_timer_ = nullptr;
+    volatile bool attempting_ = false;
+    volatile bool connected_ = false;
+    int64_t start_time_ = 0;
+
+    static std::string GetKey(const std::string& ssid);
+    static std::string DerivePmk(const std::string& ssid, const std::string& password);
+    static void SavePmkLater(const std::string& ssid, const std::string& password, const std::string& value);
+    void Connect();
+    void Fallback(const char* reason);
+    void OnWifiEvent(int32_t event_id);
+    void OnGotIp();
+};
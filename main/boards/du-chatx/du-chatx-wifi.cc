@@ -9,6 +9,7 @@
 #include "led/single_led.h"
 #include "power_manager.h"
 #include "power_save_timer.h"
+#include "settings.h"
 
 #include <wifi_station.h>
 #include <esp_log.h>
@@ -64,7 +65,9 @@ private:
             // 启用保持功能，确保睡眠期间电平不变
             rtc_gpio_hold_en(GPIO_NUM_1);
             esp_lcd_panel_disp_on_off(panel_, false); //关闭显示
-            esp_deep_sleep_start(); 
+            // 深度睡眠不会执行 shutdown handler，先提交缓存的设置
+            Settings::Flush();
+            esp_deep_sleep_start();
         });
         power_save_timer_->SetEnabled(true);
     }
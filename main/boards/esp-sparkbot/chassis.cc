@@ -11,6 +11,7 @@
 #include <driver/uart.h>
 #include <esp_log.h>
 #include <cstring>
+#include <atomic>
 
 #include "boards/esp-sparkbot/config.h"
 
@@ -20,7 +21,8 @@ namespace iot {
 
 class Chassis : public Thing {
 private:
-    light_mode_t light_mode_ = LIGHT_MODE_ALWAYS_ON;
+    // Set by the thing worker, read when the states are reported
+    std::atomic<light_mode_t> light_mode_ = LIGHT_MODE_ALWAYS_ON;
 
     void SendUartMessage(const char * command_str) {
         uint8_t len = strlen(command_str);
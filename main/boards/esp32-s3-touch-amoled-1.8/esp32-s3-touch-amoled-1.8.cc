@@ -144,6 +144,8 @@ private:
             GetBacklight()->RestoreBrightness();
         });
         power_save_timer_->OnShutdownRequest([this]() {
+            // 断电前提交缓存的设置
+            Settings::Flush();
             pmic_->PowerOff();
         });
         power_save_timer_->SetEnabled(true);
@@ -22,6 +22,7 @@
 
 #include "axp2101.h"
 #include "power_save_timer.h"
+#include "settings.h"
 
 
 #define TAG "waveshare_lcd_3_5"
@@ -126,6 +127,8 @@ private:
             GetBacklight()->RestoreBrightness();
         });
         power_save_timer_->OnShutdownRequest([this]() {
+            // 断电前提交缓存的设置
+            Settings::Flush();
             pmic_->PowerOff();
         });
         power_save_timer_->SetEnabled(true);
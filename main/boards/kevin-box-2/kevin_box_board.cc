@@ -9,6 +9,7 @@
 #include "power_save_timer.h"
 #include "axp2101.h"
 #include "assets/lang_config.h"
+#include "settings.h"
 
 #include <esp_log.h>
 #include <driver/gpio.h>
@@ -67,6 +68,8 @@ private:
     void InitializePowerSaveTimer() {
         power_save_timer_ = new PowerSaveTimer(-1, -1, 600);
         power_save_timer_->OnShutdownRequest([this]() {
+            // 断电前提交缓存的设置
+            Settings::Flush();
             pmic_->PowerOff();
         });
         power_save_timer_->SetEnabled(true);
@@ -49,7 +49,7 @@ LedStripControl::LedStripControl(CircularStrip* led_strip)
         // 保存设置
         Settings settings("led_strip", true);
         settings.SetInt("brightness", brightness_level_);
-    });
+    }, true);
 
     methods_.AddMethod("SetSingleColor", "设置单个灯颜色", ParameterList({
         Parameter("index", "灯珠索引（0-7）", kValueTypeNumber, true),
@@ -66,7 +66,7 @@ LedStripControl::LedStripControl(CircularStrip* led_strip)
         ESP_LOGI(TAG, "Set led strip single color %d to %d, %d, %d",
             index, color.red, color.green, color.blue);
         led_strip_->SetSingleColor(index, color);
-    });
+    }, true);
 
     methods_.AddMethod("SetAllColor", "设置所有灯颜色", ParameterList({
         Parameter("red", "红色（0-255）", kValueTypeNumber, true),
@@ -82,7 +82,7 @@ LedStripControl::LedStripControl(CircularStrip* led_strip)
             color.red, color.green, color.blue
         );
         led_strip_->SetAllColor(color);
-    });
+    }, true);
 
     methods_.AddMethod("Blink", "闪烁动画", ParameterList({
         Parameter("red", "红色（0-255）", kValueTypeNumber, true),
@@ -99,7 +99,7 @@ LedStripControl::LedStripControl(CircularStrip* led_strip)
         ESP_LOGI(TAG, "Blink led strip with color %d, %d, %d, interval %dms",
             color.red, color.green, color.blue, interval);
         led_strip_->Blink(color, interval);
-    });
+    }, true);
 
     methods_.AddMethod("Scroll", "跑马灯动画", ParameterList({
         Parameter("red", "红色（0-255）", kValueTypeNumber, true),
@@ -119,5 +119,5 @@ LedStripControl::LedStripControl(CircularStrip* led_strip)
         ESP_LOGI(TAG, "Scroll led strip with color %d, %d, %d, length %d, interval %dms",
             high.red, high.green, high.blue, length, interval);
         led_strip_->Scroll(low, high, length, interval);
-    });
+    }, true);
 }
@@ -7,6 +7,7 @@
 #include "i2c_device.h"
 #include "iot/thing_manager.h"
 #include "axp2101.h"
+#include "settings.h"
 
 #include <esp_log.h>
 #include <driver/i2c_master.h>
@@ -149,6 +150,8 @@ private:
             GetBacklight()->RestoreBrightness();
         });
         power_save_timer_->OnShutdownRequest([this]() {
+            // 断电前提交缓存的设置
+            Settings::Flush();
             pmic_->PowerOff();
         });
         power_save_timer_->SetEnabled(true);
@@ -12,6 +12,7 @@
 
 #include <wifi_station.h>
 #include <esp_log.h>
+#include <atomic>
 #include <esp_efuse_table.h>
 #include <driver/i2c_master.h>
 #include <esp_lcd_panel_ops.h>
@@ -29,7 +30,8 @@ private:
     esp_lcd_panel_handle_t panel_ = nullptr;
     Display* display_ = nullptr;
     Button boot_button_;
-    bool press_to_talk_enabled_ = false;
+    // Set by the thing worker, read by the button callbacks
+    std::atomic<bool> press_to_talk_enabled_ = false;
     PowerSaveTimer* power_save_timer_;
 
     void InitializePowerSaveTimer() {
@@ -14,18 +14,30 @@
 
 #define TAG "Display"
 
+// 界面更新的最短间隔，合并这段时间内的重复更新
+#define DISPLAY_PENDING_INTERVAL_MS 50
+// 来不及显示的聊天消息最多保留的条数
+#define MAX_PENDING_CHAT_MESSAGES 8
+// 还不知道本句语音时长时使用的初始语速，之后按已播放句子的实际语速估算
+#define TYPEWRITER_CHARS_PER_SECOND 6
+// 播放位置超过这个时间没有变化，认为播放已停止，剩余文字立即显示
+#define TYPEWRITER_STALL_US (1000 * 1000)
+
 Display::Display() {
     // Load theme from settings
     Settings settings("display", false);
     current_theme_name_ = settings.GetString("theme", "light");
+    typing_chars_per_second_ = TYPEWRITER_CHARS_PER_SECOND;
 
     // Notification timer
     esp_timer_create_args_t notification_timer_args = {
         .callback = [](void *arg) {
             Display *display = static_cast<Display*>(arg);
-            DisplayLockGuard lock(display);
-            lv_obj_add_flag(display->notification_label_, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_clear_flag(display->status_label_, LV_OBJ_FLAG_HIDDEN);
+            {
+                std::lock_guard<std::mutex> lock(display->pending_mutex_);
+                display->pending_status_action_ = kStatusActionHideNotification;
+            }
+            display->SchedulePending();
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
@@ -58,6 +70,9 @@ Display::Display() {
 }
 
 Display::~Display() {
+    if (pending_timer_ != nullptr) {
+        lv_timer_delete(pending_timer_);
+    }
     if (notification_timer_ != nullptr) {
         esp_timer_stop(notification_timer_);
         esp_timer_delete(notification_timer_);
@@ -84,13 +99,13 @@ Display::~Display() {
 }
 
 void Display::SetStatus(const char* status) {
-    DisplayLockGuard lock(this);
-    if (status_label_ == nullptr) {
-        return;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_status_ = status;
+        pending_status_dirty_ = true;
+        pending_status_action_ = kStatusActionStatus;
     }
-    lv_label_set_text(status_label_, status);
-    lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+    SchedulePending();
 }
 
 void Display::ShowNotification(const std::string &notification, int duration_ms) {
@@ -98,7 +113,266 @@ void Display::ShowNotification(const std::string &notification, int duration_ms)
 }
 
 void Display::ShowNotification(const char* notification, int duration_ms) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_notification_ = notification;
+        pending_notification_duration_ms_ = duration_ms;
+        pending_status_action_ = kStatusActionNotification;
+    }
+    SchedulePending();
+}
+
+void Display::SetEmotion(const char* emotion) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_emotion_ = emotion;
+        pending_emotion_is_icon_ = false;
+        pending_emotion_dirty_ = true;
+    }
+    SchedulePending();
+}
+
+void Display::SetIcon(const char* icon) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_emotion_ = icon;
+        pending_emotion_is_icon_ = true;
+        pending_emotion_dirty_ = true;
+    }
+    SchedulePending();
+}
+
+void Display::SetChatMessage(const char* role, const char* content) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if (pending_chat_messages_.size() >= MAX_PENDING_CHAT_MESSAGES) {
+            pending_chat_messages_.pop_front();
+        }
+        pending_chat_messages_.emplace_back(ChatMessage{role, content, ++pending_sequence_, 0});
+    }
+    SchedulePending();
+}
+
+void Display::AppendChatMessage(const char* role, const char* content, int64_t start_ms) {
+    if (content == nullptr || content[0] == '\0') {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if (pending_chat_segments_.size() >= MAX_PENDING_CHAT_MESSAGES) {
+            auto& last = pending_chat_segments_.back();
+            if (last.sequence == pending_sequence_ && last.role == role) {
+                // 接在上一段后面，不丢失文字
+                last.content += content;
+                SchedulePending();
+                return;
+            }
+            pending_chat_segments_.pop_front();
+        }
+        pending_chat_segments_.emplace_back(ChatMessage{role, content, ++pending_sequence_, start_ms});
+    }
+    SchedulePending();
+}
+
+void Display::StartPendingTimer() {
     DisplayLockGuard lock(this);
+    if (pending_timer_ != nullptr) {
+        return;
+    }
+    // 定时器一直运行，没有待处理的更新时只检查一次标志
+    pending_timer_ = lv_timer_create([](lv_timer_t* timer) {
+        auto display = static_cast<Display*>(lv_timer_get_user_data(timer));
+        if (display->pending_.exchange(false) && display->ApplyPending()) {
+            // 逐字显示还没有结束，下次继续
+            display->pending_ = true;
+        }
+    }, DISPLAY_PENDING_INTERVAL_MS, this);
+}
+
+void Display::SchedulePending() {
+    if (display_ == nullptr) {
+        // No LVGL display, apply in the caller
+        DisplayLockGuard lock(this);
+        ApplyPending();
+        return;
+    }
+    // Picked up by the pending timer in the LVGL task
+    pending_ = true;
+}
+
+// Returns true while there is text left to type
+bool Display::ApplyPending() {
+    std::string status;
+    std::string notification;
+    int notification_duration_ms = 0;
+    bool status_dirty;
+    StatusAction status_action;
+    std::string emotion;
+    bool emotion_is_icon = false;
+    bool emotion_dirty;
+    std::deque<ChatMessage> chat_messages;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        status_dirty = pending_status_dirty_;
+        status_action = pending_status_action_;
+        emotion_dirty = pending_emotion_dirty_;
+        if (!status_dirty && status_action == kStatusActionNone && !emotion_dirty && pending_chat_messages_.empty() &&
+            !typing_ && pending_chat_segments_.empty()) {
+            return false;
+        }
+        if (status_dirty) {
+            status = std::move(pending_status_);
+        }
+        if (status_action == kStatusActionNotification) {
+            notification = std::move(pending_notification_);
+            notification_duration_ms = pending_notification_duration_ms_;
+        }
+        if (emotion_dirty) {
+            emotion = std::move(pending_emotion_);
+            emotion_is_icon = pending_emotion_is_icon_;
+        }
+        chat_messages.swap(pending_chat_messages_);
+        pending_status_dirty_ = false;
+        pending_status_action_ = kStatusActionNone;
+        pending_emotion_dirty_ = false;
+    }
+
+    // The status text is always kept, the last action decides what is visible
+    if (status_dirty) {
+        ApplyStatus(status.c_str());
+    }
+    if (status_action == kStatusActionNotification) {
+        ApplyNotification(notification.c_str(), notification_duration_ms);
+    } else if (status_action == kStatusActionHideNotification && !status_dirty) {
+        if (notification_label_ != nullptr) {
+            lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+
+    // 表情没有变化时不重新设置
+    if (emotion_dirty && (emotion != applied_emotion_ || emotion_is_icon != applied_emotion_is_icon_)) {
+        if (emotion_is_icon) {
+            ApplyIcon(emotion.c_str());
+        } else {
+            ApplyEmotion(emotion.c_str());
+        }
+        applied_emotion_ = std::move(emotion);
+        applied_emotion_is_icon_ = emotion_is_icon;
+    }
+
+    for (auto& message : chat_messages) {
+        // Text appended before this message is shown in full first, so the order is kept
+        AdvanceTyping(message.sequence);
+        chat_continues_ = false;
+        ApplyChatMessage(message.role.c_str(), message.content.c_str());
+    }
+    AdvanceTyping(0);
+
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return typing_ || !pending_chat_segments_.empty();
+}
+
+void Display::AdvanceTyping(uint32_t flush_before) {
+    int64_t now = esp_timer_get_time();
+    int64_t position = playback_position_ms_;
+    if (position != last_playback_position_ms_) {
+        last_playback_position_ms_ = position;
+        last_playback_change_time_ = now;
+    }
+    bool stalled = now - last_playback_change_time_ > TYPEWRITER_STALL_US;
+
+    while (true) {
+        bool next_started = false;
+        int64_t next_start_ms = -1;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            if (!pending_chat_segments_.empty()) {
+                auto& next = pending_chat_segments_.front();
+                next_started = next.sequence < flush_before || stalled || next.start_ms <= position;
+            }
+            if (!typing_) {
+                if (!next_started) {
+                    return;
+                }
+                typing_segment_ = std::move(pending_chat_segments_.front());
+                pending_chat_segments_.pop_front();
+                typing_ = true;
+                typed_bytes_ = 0;
+                typed_chars_ = 0;
+                typing_total_chars_ = 0;
+                for (char c : typing_segment_.content) {
+                    if ((c & 0xC0) != 0x80) {
+                        typing_total_chars_++;
+                    }
+                }
+                typing_new_message_ = !chat_continues_ || typing_segment_.role != typing_role_;
+                typing_role_ = typing_segment_.role;
+                next_started = false;
+                if (!pending_chat_segments_.empty()) {
+                    auto& next = pending_chat_segments_.front();
+                    next_started = next.sequence < flush_before || stalled || next.start_ms <= position;
+                }
+            }
+            if (!pending_chat_segments_.empty()) {
+                next_start_ms = pending_chat_segments_.front().start_ms;
+            }
+        }
+
+        // 逐字显示，按 UTF-8 字符推进
+        const std::string& content = typing_segment_.content;
+        size_t end = content.size();
+        bool flush = next_started || typing_segment_.sequence < flush_before || stalled;
+        if (!flush) {
+            // 进度跟随播放位置，下一句的开始位置就是本句语音的结束位置
+            int64_t played_ms = position - typing_segment_.start_ms;
+            int64_t duration_ms = next_start_ms - typing_segment_.start_ms;
+            int target_chars;
+            if (next_start_ms >= 0 && duration_ms > 0) {
+                typing_chars_per_second_ = typing_total_chars_ * 1000.0f / duration_ms;
+                target_chars = played_ms * typing_total_chars_ / duration_ms + 1;
+            } else {
+                target_chars = played_ms * typing_chars_per_second_ / 1000 + 1;
+            }
+            end = typed_bytes_;
+            for (int chars = typed_chars_; chars < target_chars && end < content.size(); chars++) {
+                end++;
+                while (end < content.size() && (content[end] & 0xC0) == 0x80) {
+                    end++;
+                }
+                typed_chars_++;
+            }
+        }
+        if (end > typed_bytes_) {
+            ApplyChatAppend(typing_segment_.role.c_str(), content.substr(typed_bytes_, end - typed_bytes_).c_str(), typing_new_message_);
+            typing_new_message_ = false;
+            chat_continues_ = true;
+            typed_bytes_ = end;
+        }
+        if (typed_bytes_ < content.size()) {
+            return;
+        }
+        typing_ = false;
+    }
+}
+
+void Display::ApplyStatus(const char* status) {
+    if (status_label_ == nullptr) {
+        return;
+    }
+    // 内容和可见性没有变化时不设置，避免无意义的重绘
+    if (strcmp(lv_label_get_text(status_label_), status) != 0) {
+        lv_label_set_text(status_label_, status);
+    }
+    if (lv_obj_has_flag(status_label_, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+    if (!lv_obj_has_flag(notification_label_, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+void Display::ApplyNotification(const char* notification, int duration_ms) {
     if (notification_label_ == nullptr) {
         return;
     }
@@ -193,7 +467,7 @@ void Display::Update() {
 }
 
 
-void Display::SetEmotion(const char* emotion) {
+void Display::ApplyEmotion(const char* emotion) {
     struct Emotion {
         const char* icon;
         const char* text;
@@ -228,7 +502,6 @@ void Display::SetEmotion(const char* emotion) {
     auto it = std::find_if(emotions.begin(), emotions.end(),
         [&emotion_view](const Emotion& e) { return e.text == emotion_view; });
     
-    DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
     }
@@ -241,16 +514,23 @@ void Display::SetEmotion(const char* emotion) {
     }
 }
 
-void Display::SetIcon(const char* icon) {
-    DisplayLockGuard lock(this);
+void Display::ApplyIcon(const char* icon) {
     if (emotion_label_ == nullptr) {
         return;
     }
     lv_label_set_text(emotion_label_, icon);
 }
 
-void Display::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
+void Display::ApplyChatAppend(const char* role, const char* content, bool new_message) {
+    if (new_message) {
+        appended_text_ = content;
+    } else {
+        appended_text_ += content;
+    }
+    ApplyChatMessage(role, appended_text_.c_str());
+}
+
+void Display::ApplyChatMessage(const char* role, const char* content) {
     if (chat_message_label_ == nullptr) {
         return;
     }
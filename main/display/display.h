@@ -7,6 +7,9 @@
 #include <esp_pm.h>
 
 #include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
 
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
@@ -19,15 +22,19 @@ public:
     Display();
     virtual ~Display();
 
+    // The setters only queue the update, it is applied later from the LVGL task
     virtual void SetStatus(const char* status);
     virtual void ShowNotification(const char* notification, int duration_ms = 3000);
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
     virtual void SetChatMessage(const char* role, const char* content);
+    // Append text to the current message of the role, typed out once the playback position reaches start_ms
+    virtual void AppendChatMessage(const char* role, const char* content, int64_t start_ms = 0);
     virtual void SetIcon(const char* icon);
     virtual void SetTheme(const std::string& theme_name);
     virtual std::string GetTheme() { return current_theme_name_; }
 
+    inline void SetPlaybackPosition(int64_t position_ms) { playback_position_ms_ = position_ms; }
     inline int width() const { return width_; }
     inline int height() const { return height_; }
 
@@ -61,6 +68,68 @@ protected:
     virtual void Unlock() = 0;
 
     virtual void Update();
+    // Start applying the queued updates in the LVGL task, called once the LVGL display is created
+    void StartPendingTimer();
+
+    // Apply the updates to the LVGL objects, called with the display locked
+    virtual void ApplyStatus(const char* status);
+    virtual void ApplyNotification(const char* notification, int duration_ms);
+    virtual void ApplyEmotion(const char* emotion);
+    virtual void ApplyIcon(const char* icon);
+    virtual void ApplyChatMessage(const char* role, const char* content);
+    // Append to the last message, or start a new one if new_message is true
+    virtual void ApplyChatAppend(const char* role, const char* content, bool new_message);
+
+private:
+    // 待显示的更新，状态和表情只保留最后一次，聊天消息按顺序保留
+    struct ChatMessage {
+        std::string role;
+        std::string content;
+        uint32_t sequence;
+        int64_t start_ms;
+    };
+    enum StatusAction {
+        kStatusActionNone,
+        kStatusActionStatus,
+        kStatusActionNotification,
+        kStatusActionHideNotification,
+    };
+    std::mutex pending_mutex_;
+    std::string pending_status_;
+    bool pending_status_dirty_ = false;
+    std::string pending_notification_;
+    int pending_notification_duration_ms_ = 0;
+    StatusAction pending_status_action_ = kStatusActionNone;
+    std::string pending_emotion_;
+    bool pending_emotion_is_icon_ = false;
+    bool pending_emotion_dirty_ = false;
+    std::string applied_emotion_;
+    bool applied_emotion_is_icon_ = false;
+    std::deque<ChatMessage> pending_chat_messages_;
+    std::deque<ChatMessage> pending_chat_segments_;
+    uint32_t pending_sequence_ = 0;
+    lv_timer_t* pending_timer_ = nullptr;
+    // 有待处理的更新，调用方只设置这个标志，不需要获取 LVGL 锁
+    std::atomic<bool> pending_ = false;
+
+    // 逐字显示的状态，只在 LVGL 任务中访问
+    std::atomic<int64_t> playback_position_ms_ = 0;
+    int64_t last_playback_position_ms_ = -1;
+    int64_t last_playback_change_time_ = 0;
+    ChatMessage typing_segment_;
+    bool typing_ = false;
+    bool typing_new_message_ = false;
+    size_t typed_bytes_ = 0;
+    int typed_chars_ = 0;
+    int typing_total_chars_ = 0;
+    float typing_chars_per_second_ = 0;
+    bool chat_continues_ = false;
+    std::string typing_role_;
+    std::string appended_text_;
+
+    void SchedulePending();
+    bool ApplyPending();
+    void AdvanceTyping(uint32_t flush_before);
 };
 
 
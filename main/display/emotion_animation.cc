@@ -0,0 +1,290 @@
+#include "emotion_animation.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "EmotionAnimation"
+
+#define EMOTION_PARTITION_LABEL "emotions"
+// Upper bound of PSRAM used by decoded frames
+#define EMOTION_FRAME_CACHE_BYTES (256 * 1024)
+// Give up building the perfect hash after this many seeds
+#define EMOTION_HASH_MAX_SEEDS 1000
+
+EmotionAnimation::EmotionAnimation() {
+}
+
+EmotionAnimation::~EmotionAnimation() {
+    if (timer_ != nullptr) {
+        lv_timer_delete(timer_);
+    }
+    for (auto& frame : frame_cache_) {
+        heap_caps_free((void*)frame.dsc.data);
+    }
+    if (atlas_ != nullptr) {
+        esp_partition_munmap(mmap_handle_);
+    }
+}
+
+bool EmotionAnimation::Load() {
+#if CONFIG_SPIRAM
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, EMOTION_PARTITION_LABEL);
+    if (partition == nullptr) {
+        ESP_LOGI(TAG, "No emotion partition, using static emotions");
+        return false;
+    }
+
+    const void* data = nullptr;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &data, &mmap_handle_);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map emotion partition: %s", esp_err_to_name(err));
+        return false;
+    }
+    atlas_ = (const uint8_t*)data;
+    atlas_size_ = partition->size;
+
+    auto header = (const EmotionAtlasHeader*)atlas_;
+    size_t tables_size = sizeof(EmotionAtlasHeader) + header->emotion_count * sizeof(EmotionAtlasEmotion)
+        + header->frame_count * sizeof(EmotionAtlasFrame);
+    if (header->magic != EMOTION_ATLAS_MAGIC || header->version != EMOTION_ATLAS_VERSION ||
+        header->fps == 0 || header->width == 0 || header->height == 0 || tables_size > atlas_size_) {
+        ESP_LOGW(TAG, "Emotion partition does not contain a valid atlas");
+        esp_partition_munmap(mmap_handle_);
+        atlas_ = nullptr;
+        return false;
+    }
+    emotions_ = (const EmotionAtlasEmotion*)(atlas_ + sizeof(EmotionAtlasHeader));
+    frames_ = (const EmotionAtlasFrame*)(emotions_ + header->emotion_count);
+    header_ = header;
+
+    if (!BuildHashTable()) {
+        ESP_LOGE(TAG, "Failed to build emotion hash table");
+        header_ = nullptr;
+        esp_partition_munmap(mmap_handle_);
+        atlas_ = nullptr;
+        return false;
+    }
+
+    size_t frame_bytes = header_->width * header_->height * sizeof(uint16_t);
+    max_cached_frames_ = EMOTION_FRAME_CACHE_BYTES / frame_bytes;
+    if (max_cached_frames_ < 2) {
+        max_cached_frames_ = 2;
+    }
+    ESP_LOGI(TAG, "Loaded %u emotions, %u frames of %ux%u at %u fps, cache %u frames",
+        header_->emotion_count, header_->frame_count, header_->width, header_->height, header_->fps, (unsigned)max_cached_frames_);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// FNV-1a
+uint32_t EmotionAnimation::Hash(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (int i = 0; i < EMOTION_NAME_SIZE && name[i] != '\0'; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool EmotionAnimation::BuildHashTable() {
+    // A table twice the size of the set, try seeds until there is no collision
+    size_t size = 1;
+    while (size < header_->emotion_count * 2u) {
+        size <<= 1;
+    }
+    hash_table_.assign(size, -1);
+    for (uint32_t seed = 0; seed < EMOTION_HASH_MAX_SEEDS; seed++) {
+        std::fill(hash_table_.begin(), hash_table_.end(), -1);
+        bool collision = false;
+        for (int i = 0; i < header_->emotion_count && !collision; i++) {
+            auto& slot = hash_table_[Hash(emotions_[i].name, seed) & (size - 1)];
+            if (slot >= 0) {
+                collision = true;
+            } else {
+                slot = i;
+            }
+        }
+        if (!collision) {
+            hash_seed_ = seed;
+            return true;
+        }
+    }
+    return false;
+}
+
+int EmotionAnimation::FindEmotion(const char* name) const {
+    if (hash_table_.empty()) {
+        return -1;
+    }
+    int index = hash_table_[Hash(name, hash_seed_) & (hash_table_.size() - 1)];
+    if (index < 0 || strncmp(emotions_[index].name, name, EMOTION_NAME_SIZE) != 0) {
+        return -1;
+    }
+    return index;
+}
+
+void EmotionAnimation::Attach(lv_obj_t* parent, lv_obj_t* emotion_label, int max_height) {
+    if (header_ == nullptr) {
+        return;
+    }
+    emotion_label_ = emotion_label;
+    image_ = lv_image_create(parent);
+    if (max_height > 0 && header_->height > max_height) {
+        // Scaled while drawing, an atlas generated at this size avoids the cost
+        lv_obj_set_size(image_, header_->width * max_height / header_->height, max_height);
+        lv_image_set_inner_align(image_, LV_IMAGE_ALIGN_STRETCH);
+        ESP_LOGW(TAG, "Emotion frames %dx%d are scaled down to height %d", header_->width, header_->height, max_height);
+    } else {
+        lv_obj_set_size(image_, header_->width, header_->height);
+    }
+    // Take the place of the emotion label in the layout
+    lv_obj_move_to_index(image_, lv_obj_get_index(emotion_label));
+    lv_obj_add_flag(image_, LV_OBJ_FLAG_HIDDEN);
+
+    timer_ = lv_timer_create([](lv_timer_t* timer) {
+        auto self = static_cast<EmotionAnimation*>(lv_timer_get_user_data(timer));
+        self->OnTimer();
+    }, 1000 / header_->fps, this);
+    lv_timer_pause(timer_);
+}
+
+bool EmotionAnimation::Play(const char* emotion) {
+    if (image_ == nullptr) {
+        return false;
+    }
+    int index = FindEmotion(emotion);
+    if (index < 0) {
+        Stop();
+        return false;
+    }
+    if (current_ != &emotions_[index]) {
+        current_ = &emotions_[index];
+        current_frame_ = -1;
+        start_time_ = esp_timer_get_time();
+        OnTimer();
+    }
+    lv_obj_add_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_clear_flag(image_, LV_OBJ_FLAG_HIDDEN);
+    // Single frame emotions are static, no need to wake up the timer
+    if (current_->frame_count > 1) {
+        lv_timer_resume(timer_);
+    } else {
+        lv_timer_pause(timer_);
+    }
+    return true;
+}
+
+void EmotionAnimation::Stop() {
+    if (image_ == nullptr) {
+        return;
+    }
+    current_ = nullptr;
+    lv_timer_pause(timer_);
+    lv_obj_add_flag(image_, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+}
+
+void EmotionAnimation::OnTimer() {
+    if (current_ == nullptr || current_->frame_count == 0) {
+        return;
+    }
+    // The frame is picked by the elapsed time, so a late timer skips frames instead of slowing down
+    int64_t elapsed = esp_timer_get_time() - start_time_;
+    int frame = (elapsed * header_->fps / 1000000) % current_->frame_count;
+    if (frame == current_frame_) {
+        return;
+    }
+    if (current_frame_ >= 0) {
+        frames_skipped_ += (frame - current_frame_ - 1 + current_->frame_count) % current_->frame_count;
+    }
+
+    auto dsc = GetFrame(current_->first_frame + frame);
+    if (dsc == nullptr) {
+        return;
+    }
+    current_frame_ = frame;
+    frames_shown_++;
+    lv_image_set_src(image_, dsc);
+}
+
+const lv_image_dsc_t* EmotionAnimation::GetFrame(int index) {
+    for (auto it = frame_cache_.begin(); it != frame_cache_.end(); ++it) {
+        if (it->index == index) {
+            // Move to the front as the most recently used
+            frame_cache_.splice(frame_cache_.begin(), frame_cache_, it);
+            return &frame_cache_.front().dsc;
+        }
+    }
+
+    uint16_t* pixels = nullptr;
+    if (frame_cache_.size() >= max_cached_frames_) {
+        // Reuse the buffer of the least recently used frame
+        auto& last = frame_cache_.back();
+        lv_image_cache_drop(&last.dsc);
+        pixels = (uint16_t*)last.dsc.data;
+        frame_cache_.pop_back();
+    } else {
+        pixels = (uint16_t*)heap_caps_malloc(header_->width * header_->height * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+        if (pixels == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate frame buffer");
+            return nullptr;
+        }
+    }
+
+    int64_t start = esp_timer_get_time();
+    if (!DecodeFrame(index, pixels)) {
+        heap_caps_free(pixels);
+        return nullptr;
+    }
+    int64_t decode_time = esp_timer_get_time() - start;
+    frames_decoded_++;
+    decode_time_us_ += decode_time;
+    if (decode_time > max_decode_time_us_) {
+        max_decode_time_us_ = decode_time;
+    }
+
+    CachedFrame cached = {};
+    cached.index = index;
+    cached.dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+    cached.dsc.header.cf = LV_COLOR_FORMAT_RGB565;
+    cached.dsc.header.w = header_->width;
+    cached.dsc.header.h = header_->height;
+    cached.dsc.header.stride = header_->width * sizeof(uint16_t);
+    cached.dsc.data_size = header_->width * header_->height * sizeof(uint16_t);
+    cached.dsc.data = (const uint8_t*)pixels;
+    frame_cache_.push_front(cached);
+    return &frame_cache_.front().dsc;
+}
+
+bool EmotionAnimation::DecodeFrame(int index, uint16_t* pixels) {
+    if (index >= header_->frame_count) {
+        return false;
+    }
+    auto& frame = frames_[index];
+    if (frame.offset + frame.size > atlas_size_ || frame.size % 4 != 0) {
+        ESP_LOGE(TAG, "Invalid frame %d", index);
+        return false;
+    }
+
+    auto runs = (const uint16_t*)(atlas_ + frame.offset);
+    DecodeEmotionFrame(runs, frame.size / 4, pixels, header_->width * header_->height);
+    return true;
+}
+
+void EmotionAnimation::LogStats() {
+    if (frames_shown_ == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "Emotion frames: %lu shown, %lu skipped, %lu decoded, decode avg %lld us max %lld us",
+        frames_shown_, frames_skipped_, frames_decoded_,
+        frames_decoded_ > 0 ? decode_time_us_ / frames_decoded_ : 0, max_decode_time_us_);
+    frames_shown_ = 0;
+    frames_skipped_ = 0;
+    frames_decoded_ = 0;
+    decode_time_us_ = 0;
+    max_decode_time_us_ = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef EMOTION_ANIMATION_H
+#define EMOTION_ANIMATION_H
+
+#include "emotion_atlas.h"
+
+#include <lvgl.h>
+#include <esp_partition.h>
+
+#include <vector>
+#include <list>
+#include <cstdint>
+
+// Plays emotion animations from the frame atlas in the "emotions" partition.
+// The atlas is memory mapped, frames are RLE encoded RGB565 and decoded on demand
+// into a small frame cache in PSRAM. Only the image object is invalidated per frame.
+class EmotionAnimation {
+public:
+    EmotionAnimation();
+    ~EmotionAnimation();
+
+    // Map the atlas partition, returns false if there is no valid atlas
+    bool Load();
+    // Create the image object, must be called with the display locked.
+    // Frames taller than max_height are scaled down to it, 0 shows them at their own size
+    void Attach(lv_obj_t* parent, lv_obj_t* emotion_label, int max_height = 0);
+    // Start the animation of the emotion, returns false if the atlas does not have it
+    bool Play(const char* emotion);
+    void Stop();
+    void LogStats();
+
+    inline bool loaded() const { return header_ != nullptr; }
+
+private:
+    struct CachedFrame {
+        int index;
+        lv_image_dsc_t dsc;
+    };
+
+    esp_partition_mmap_handle_t mmap_handle_ = 0;
+    const uint8_t* atlas_ = nullptr;
+    size_t atlas_size_ = 0;
+    const EmotionAtlasHeader* header_ = nullptr;
+    const EmotionAtlasEmotion* emotions_ = nullptr;
+    const EmotionAtlasFrame* frames_ = nullptr;
+
+    // Perfect hash from emotion name to emotion index
+    std::vector<int16_t> hash_table_;
+    uint32_t hash_seed_ = 0;
+
+    std::list<CachedFrame> frame_cache_;
+    size_t max_cached_frames_ = 0;
+
+    lv_obj_t* image_ = nullptr;
+    lv_obj_t* emotion_label_ = nullptr;
+    lv_timer_t* timer_ = nullptr;
+    const EmotionAtlasEmotion* current_ = nullptr;
+    int current_frame_ = -1;
+    int64_t start_time_ = 0;
+
+    uint32_t frames_shown_ = 0;
+    uint32_t frames_skipped_ = 0;
+    uint32_t frames_decoded_ = 0;
+    int64_t decode_time_us_ = 0;
+    int64_t max_decode_time_us_ = 0;
+
+    static uint32_t Hash(const char* name, uint32_t seed);
+    bool BuildHashTable();
+    int FindEmotion(const char* name) const;
+    const lv_image_dsc_t* GetFrame(int index);
+    bool DecodeFrame(int index, uint16_t* pixels);
+    void OnTimer();
+};
+
+#endif // EMOTION_ANIMATION_H
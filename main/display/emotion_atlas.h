@@ -0,0 +1,57 @@
+#ifndef EMOTION_ATLAS_H
+#define EMOTION_ATLAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Atlas layout (little endian, generated by scripts/emotion_atlas.py):
+//   header   EmotionAtlasHeader
+//   emotions EmotionAtlasEmotion[emotion_count]
+//   frames   EmotionAtlasFrame[frame_count]
+//   data     RLE runs of (uint16 count, uint16 rgb565 color)
+#define EMOTION_ATLAS_MAGIC 0x414F4D45  // "EMOA"
+#define EMOTION_ATLAS_VERSION 1
+#define EMOTION_NAME_SIZE 16
+
+struct EmotionAtlasHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t emotion_count;
+    uint16_t frame_count;
+    uint16_t width;
+    uint16_t height;
+    uint16_t fps;
+};
+
+struct EmotionAtlasEmotion {
+    char name[EMOTION_NAME_SIZE];
+    uint16_t first_frame;
+    uint16_t frame_count;
+};
+
+struct EmotionAtlasFrame {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Decode the RLE runs of one frame into total RGB565 pixels, the rest is filled with black.
+// Kept free of LVGL and ESP-IDF so the host benchmark runs the same code as the device.
+inline void DecodeEmotionFrame(const uint16_t* runs, size_t run_count, uint16_t* pixels, size_t total) {
+    size_t pos = 0;
+    for (size_t i = 0; i < run_count && pos < total; i++) {
+        uint16_t count = runs[i * 2];
+        uint16_t color = runs[i * 2 + 1];
+        if (count > total - pos) {
+            count = total - pos;
+        }
+        for (uint16_t j = 0; j < count; j++) {
+            pixels[pos++] = color;
+        }
+    }
+    if (pos < total) {
+        memset(pixels + pos, 0, (total - pos) * sizeof(uint16_t));
+    }
+}
+
+#endif // EMOTION_ATLAS_H
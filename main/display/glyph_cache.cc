@@ -0,0 +1,109 @@
+#include "glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "GlyphCache"
+
+// Upper bound of PSRAM used by cached glyphs
+#define GLYPH_CACHE_MAX_BYTES (192 * 1024)
+
+GlyphCache::~GlyphCache() {
+    for (auto& entry : entries_) {
+        heap_caps_free(entry.data);
+    }
+}
+
+const lv_font_t* GlyphCache::Wrap(const lv_font_t* font) {
+#if CONFIG_SPIRAM
+    if (font == nullptr || font->get_glyph_bitmap == nullptr) {
+        return font;
+    }
+    // The copy shares the glyph data of the original font, only the bitmap callback is replaced.
+    // LVGL resolves the glyphs to the copy, so its callback is the one used for drawing.
+    auto wrapped = std::make_unique<lv_font_t>(*font);
+    wrapped->user_data = (void*)font;
+    wrapped->get_glyph_bitmap = GetGlyphBitmap;
+    fonts_.emplace_back(std::move(wrapped));
+    return fonts_.back().get();
+#else
+    return font;
+#endif
+}
+
+const void* GlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    return GetInstance().Lookup(g_dsc, draw_buf);
+}
+
+// Called from the LVGL task only, no locking needed
+const void* GlyphCache::Lookup(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto font = static_cast<const lv_font_t*>(g_dsc->resolved_font->user_data);
+    if (draw_buf == nullptr) {
+        return font->get_glyph_bitmap(g_dsc, draw_buf);
+    }
+
+    uint64_t key = ((uint64_t)(uintptr_t)font << 32) | g_dsc->gid.index;
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        auto& entry = *it->second;
+        if (entry.stride == draw_buf->header.stride && entry.height == draw_buf->header.h) {
+            memcpy(draw_buf->data, entry.data, entry.size);
+            // Move to the front as the most recently used
+            entries_.splice(entries_.begin(), entries_, it->second);
+            hits_++;
+            return draw_buf;
+        }
+    }
+
+    misses_++;
+    auto bitmap = font->get_glyph_bitmap(g_dsc, draw_buf);
+    // Only the bitmaps rendered into the draw buffer are cached, raw pointers into the font are already cheap
+    if (bitmap == draw_buf) {
+        Insert(key, draw_buf);
+    }
+    return bitmap;
+}
+
+void GlyphCache::Insert(uint64_t key, const lv_draw_buf_t* draw_buf) {
+    uint32_t size = draw_buf->header.stride * draw_buf->header.h;
+    if (size == 0 || size > GLYPH_CACHE_MAX_BYTES / 16) {
+        return;
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        cache_bytes_ -= it->second->size;
+        heap_caps_free(it->second->data);
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    // Evict the least recently used glyphs
+    while (!entries_.empty() && cache_bytes_ + size > GLYPH_CACHE_MAX_BYTES) {
+        auto& last = entries_.back();
+        cache_bytes_ -= last.size;
+        heap_caps_free(last.data);
+        index_.erase(last.key);
+        entries_.pop_back();
+    }
+
+    auto data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        return;
+    }
+    memcpy(data, draw_buf->data, size);
+    entries_.push_front(Entry{key, data, size, draw_buf->header.stride, draw_buf->header.h});
+    index_[key] = entries_.begin();
+    cache_bytes_ += size;
+}
+
+void GlyphCache::LogStats() {
+    uint32_t hits = hits_.exchange(0);
+    uint32_t misses = misses_.exchange(0);
+    if (hits + misses == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "Glyph cache: %lu hits, %lu misses (%.1f%%), %u glyphs, %u bytes",
+        hits, misses, hits * 100.0f / (hits + misses), (unsigned)entries_.size(), (unsigned)cache_bytes_);
+}
@@ -0,0 +1,52 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <lvgl.h>
+
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+
+// LRU cache of rendered glyph bitmaps in PSRAM.
+// Compressed fonts are decompressed by LVGL every time a glyph is drawn, the cache
+// keeps the decompressed A8 bitmaps so that redrawing streamed text is a memcpy.
+class GlyphCache {
+public:
+    static GlyphCache& GetInstance() {
+        static GlyphCache instance;
+        return instance;
+    }
+    // Delete copy constructor and assignment operator
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    // Return a copy of the font whose bitmaps go through the cache
+    const lv_font_t* Wrap(const lv_font_t* font);
+    void LogStats();
+
+private:
+    GlyphCache() = default;
+    ~GlyphCache();
+
+    struct Entry {
+        uint64_t key;
+        uint8_t* data;
+        uint32_t size;
+        uint32_t stride;
+        uint32_t height;
+    };
+
+    std::list<std::unique_ptr<lv_font_t>> fonts_;
+    std::list<Entry> entries_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+    size_t cache_bytes_ = 0;
+    std::atomic<uint32_t> hits_ = 0;
+    std::atomic<uint32_t> misses_ = 0;
+
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    const void* Lookup(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    void Insert(uint64_t key, const lv_draw_buf_t* draw_buf);
+};
+
+#endif // GLYPH_CACHE_H
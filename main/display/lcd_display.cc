@@ -5,6 +5,7 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
+#include <esp_heap_caps.h>
 #include "assets/lang_config.h"
 #include <cstring>
 #include "settings.h"
@@ -112,7 +113,8 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         .panel_handle = panel_,
         .control_handle = nullptr,
         .buffer_size = static_cast<uint32_t>(width_ * 10),
-        .double_buffer = false,
+        // 两个内部 RAM 的 DMA 缓冲区，渲染下一块时上一块还在通过 SPI 传输
+        .double_buffer = true,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -151,6 +153,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     }
 
     SetupUI();
+    StartPendingTimer();
 }
 
 // RGB LCD实现
@@ -223,6 +226,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     }
 
     SetupUI();
+    StartPendingTimer();
 }
 
 LcdDisplay::~LcdDisplay() {
@@ -259,9 +263,48 @@ void LcdDisplay::Unlock() {
     lvgl_port_unlock();
 }
 
+#define FLUSH_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+void LcdDisplay::SetupFlushStats() {
+    if (display_ == nullptr) {
+        return;
+    }
+    // LVGL 只刷新脏区域，这里统计实际刷到屏幕上的次数和数据量
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        auto area = static_cast<const lv_area_t*>(lv_event_get_param(e));
+        self->flush_count_++;
+        if (area != nullptr) {
+            self->flush_bytes_ += lv_area_get_size(area) * sizeof(uint16_t);
+        }
+    }, LV_EVENT_FLUSH_START, this);
+    flush_stats_start_time_ = esp_timer_get_time();
+}
+
+void LcdDisplay::Update() {
+    Display::Update();
+
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - flush_stats_start_time_;
+    if (flush_stats_start_time_ == 0 || elapsed < FLUSH_STATS_INTERVAL_US) {
+        return;
+    }
+    uint32_t count = flush_count_.exchange(0);
+    uint32_t bytes = flush_bytes_.exchange(0);
+    flush_stats_start_time_ = now;
+    if (count > 0) {
+        ESP_LOGI(TAG, "Flush: %.1f times/s, %.1f KB/s", count * 1000000.0f / elapsed, bytes * 1000000.0f / elapsed / 1024);
+    }
+    // 字形缓存和表情动画的统计由 LVGL 任务更新
+    DisplayLockGuard lock(this);
+    GlyphCache::GetInstance().LogStats();
+    emotion_animation_.LogStats();
+}
+
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    SetupFlushStats();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
@@ -303,8 +346,9 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, 10, 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Message bubbles are created once and reused by SetChatMessage
     chat_message_label_ = nullptr;
+    CreateMessageSlots();
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -325,6 +369,10 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(emotion_label_, current_theme.text, 0);
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
     lv_obj_set_style_margin_right(emotion_label_, 5, 0); // 添加右边距，与后面的元素分隔
+    if (emotion_animation_.Load()) {
+        // 状态栏只有一行高，动画缩小到图标字体的高度
+        emotion_animation_.Attach(status_bar_, emotion_label_, font_awesome_30_4.line_height);
+    }
 
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
@@ -368,176 +416,258 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+
+#if CONFIG_CHAT_MESSAGE_BENCHMARK
+    RunChatBenchmark();
+#endif
 }
 
-#define  MAX_MESSAGES 20
-void LcdDisplay::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
+#define MAX_MESSAGES 20
+// 所有气泡保留的文本总字节数上限，超过时隐藏最早的消息
+#define MAX_MESSAGE_TEXT_BYTES 4096
+// 只测量开头这么多字节就能判断是否需要换行
+#define MESSAGE_MEASURE_BYTES 64
+
+void LcdDisplay::CreateMessageSlots() {
+    message_slots_.resize(MAX_MESSAGES);
+    for (auto& slot : message_slots_) {
+        // 每条消息都是一个全宽透明容器，气泡在其中左对齐、居中或右对齐
+        slot.row = lv_obj_create(content_);
+        lv_obj_set_width(slot.row, LV_HOR_RES);
+        lv_obj_set_height(slot.row, LV_SIZE_CONTENT);
+        lv_obj_set_style_bg_opa(slot.row, LV_OPA_TRANSP, 0);
+        lv_obj_set_style_border_width(slot.row, 0, 0);
+        lv_obj_set_style_pad_all(slot.row, 0, 0);
+        lv_obj_set_scrollbar_mode(slot.row, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_add_flag(slot.row, LV_OBJ_FLAG_HIDDEN);
+
+        slot.bubble = lv_obj_create(slot.row);
+        lv_obj_set_style_radius(slot.bubble, 8, 0);
+        lv_obj_set_scrollbar_mode(slot.bubble, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_style_border_width(slot.bubble, 1, 0);
+        lv_obj_set_style_border_color(slot.bubble, current_theme.border, 0);
+        lv_obj_set_style_pad_all(slot.bubble, 8, 0);
+        lv_obj_set_size(slot.bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+        lv_obj_set_style_flex_grow(slot.bubble, 0, 0);
+        lv_obj_set_user_data(slot.bubble, (void*)"assistant");
+
+        slot.label = lv_label_create(slot.bubble);
+        lv_label_set_long_mode(slot.label, LV_LABEL_LONG_WRAP);
+        lv_obj_set_style_text_font(slot.label, fonts_.text_font, 0);
+        lv_label_set_text_static(slot.label, "");
+    }
+    next_message_slot_ = 0;
+    message_text_bytes_ = 0;
+}
+
+void LcdDisplay::ReleaseMessageSlot(MessageSlot& slot) {
+    if (lv_obj_has_flag(slot.row, LV_OBJ_FLAG_HIDDEN)) {
         return;
     }
-    
-    //避免出现空的消息框
-    if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
+    lv_obj_add_flag(slot.row, LV_OBJ_FLAG_HIDDEN);
+    lv_label_set_text_static(slot.label, "");
+    message_text_bytes_ -= slot.text_bytes;
+    slot.text_bytes = 0;
+}
+
+void LcdDisplay::EvictMessageText(MessageSlot& keep, size_t incoming) {
+    // 保留的文本过多时，从最早的消息开始隐藏
+    for (size_t i = 0; i < message_slots_.size() && message_text_bytes_ + incoming > MAX_MESSAGE_TEXT_BYTES; i++) {
+        auto& oldest = message_slots_[(next_message_slot_ + i) % message_slots_.size()];
+        if (&oldest != &keep) {
+            ReleaseMessageSlot(oldest);
+        }
+    }
+}
+
+#if CONFIG_CHAT_MESSAGE_BENCHMARK
+#define CHAT_BENCHMARK_MESSAGES 200
+// 每条助手消息分成几段追加，模拟 sentence_start 流式输出
+#define CHAT_BENCHMARK_APPENDS 4
+
+// 在真实屏幕上连续流式显示消息，统计堆分配和每帧耗时
+void LcdDisplay::RunChatBenchmark() {
+    static const char* kSegment = "今天天气不错，适合出去走走。";
+
+    multi_heap_info_t heap_before, heap_after;
+    heap_caps_get_info(&heap_before, MALLOC_CAP_8BIT);
+    lv_mem_monitor_t lv_before, lv_after;
+    lv_mem_monitor(&lv_before);
+
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    int frames = 0;
+    auto refresh = [&]() {
+        int64_t start = esp_timer_get_time();
+        lv_refr_now(display_);
+        int64_t cost = esp_timer_get_time() - start;
+        total_us += cost;
+        max_us = cost > max_us ? cost : max_us;
+        frames++;
+    };
+
+    int64_t start_time = esp_timer_get_time();
+    for (int i = 0; i < CHAT_BENCHMARK_MESSAGES; i++) {
+        if (i % 2 == 0) {
+            ApplyChatMessage("user", kSegment);
+            refresh();
+            continue;
         }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+        for (int j = 0; j < CHAT_BENCHMARK_APPENDS; j++) {
+            ApplyChatAppend("assistant", kSegment, j == 0);
+            refresh();
         }
     }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+    int64_t elapsed_us = esp_timer_get_time() - start_time;
+
+    heap_caps_get_info(&heap_after, MALLOC_CAP_8BIT);
+    lv_mem_monitor(&lv_after);
+    ESP_LOGI(TAG, "Chat benchmark: %d messages in %lld ms, %d frames, avg %lld us, max %lld us",
+        CHAT_BENCHMARK_MESSAGES, elapsed_us / 1000, frames, total_us / frames, max_us);
+    ESP_LOGI(TAG, "Chat benchmark: heap blocks %d -> %d, bytes %d -> %d, lvgl used %lu -> %lu",
+        (int)heap_before.allocated_blocks, (int)heap_after.allocated_blocks,
+        (int)heap_before.total_allocated_bytes, (int)heap_after.total_allocated_bytes,
+        (unsigned long)(lv_before.total_size - lv_before.free_size),
+        (unsigned long)(lv_after.total_size - lv_after.free_size));
+
+    for (auto& slot : message_slots_) {
+        ReleaseMessageSlot(slot);
+    }
+    chat_message_label_ = nullptr;
+}
+#endif
 
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
+void LcdDisplay::ApplyChatAppend(const char* role, const char* content, bool new_message) {
+    if (content_ == nullptr || message_slots_.empty()) {
+        return;
+    }
+    auto& slot = message_slots_[(next_message_slot_ + message_slots_.size() - 1) % message_slots_.size()];
+    if (new_message || lv_obj_has_flag(slot.row, LV_OBJ_FLAG_HIDDEN)) {
+        ApplyChatMessage(role, content);
+        return;
     }
 
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
+    // 只在末尾追加文字，不重新创建气泡
+    size_t length = strlen(content);
+    EvictMessageText(slot, length);
+    lv_label_ins_text(slot.label, LV_LABEL_POS_LAST, content);
+    slot.text_bytes += length;
+    message_text_bytes_ += length;
+
+    // 单条消息本身超过上限时，丢弃开头的文字
+    if (slot.text_bytes > MAX_MESSAGE_TEXT_BYTES) {
+        const char* text = lv_label_get_text(slot.label);
+        size_t drop = slot.text_bytes - MAX_MESSAGE_TEXT_BYTES;
+        // 不要截断 UTF-8 字符
+        while (drop < slot.text_bytes && (text[drop] & 0xC0) == 0x80) {
+            drop++;
+        }
+        lv_label_set_text(slot.label, text + drop);
+        slot.text_bytes -= drop;
+        message_text_bytes_ -= drop;
+    }
+
+    // 气泡还没到最大宽度时才需要重新计算宽度
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    if (lv_obj_get_style_width(slot.label, 0) < max_width) {
+        const char* text = lv_label_get_text(slot.label);
+        lv_coord_t text_width = lv_txt_get_width(text, strlen(text), fonts_.text_font, 0);
+        lv_obj_set_width(slot.label, text_width < max_width ? text_width : max_width);
+    }
+    lv_obj_scroll_to_view_recursive(slot.row, LV_ANIM_OFF);
+}
+
+void LcdDisplay::ApplyChatMessage(const char* role, const char* content) {
+    if (content_ == nullptr || message_slots_.empty()) {
+        return;
     }
     
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
+    //避免出现空的消息框
+    size_t length = strlen(content);
+    if (length == 0) return;
+
+    // 单条消息超过上限时，和追加文字一样只保留末尾的文字
+    if (length > MAX_MESSAGE_TEXT_BYTES) {
+        size_t drop = length - MAX_MESSAGE_TEXT_BYTES;
+        // 不要截断 UTF-8 字符
+        while (drop < length && (content[drop] & 0xC0) == 0x80) {
+            drop++;
+        }
+        content += drop;
+        length -= drop;
+    }
+
+    // 复用最早的气泡，移到列表末尾
+    auto& slot = message_slots_[next_message_slot_];
+    next_message_slot_ = (next_message_slot_ + 1) % message_slots_.size();
+    ReleaseMessageSlot(slot);
 
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+    EvictMessageText(slot, length);
+
+    lv_label_set_text(slot.label, content);
+    slot.text_bytes = length;
+    message_text_bytes_ += length;
+
+    // 计算文本实际宽度，长文本只测量开头部分，已经超过最大宽度就不再测量全文
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
+    lv_coord_t min_width = 20;
+    lv_coord_t text_width = max_width;
+    size_t measure_bytes = length;
+    if (measure_bytes > MESSAGE_MEASURE_BYTES) {
+        measure_bytes = MESSAGE_MEASURE_BYTES;
+        // 不要截断 UTF-8 字符
+        while (measure_bytes > 0 && (content[measure_bytes] & 0xC0) == 0x80) {
+            measure_bytes--;
+        }
+        text_width = lv_txt_get_width(content, measure_bytes, fonts_.text_font, 0);
+        measure_bytes = text_width < max_width ? length : 0;
+    }
+    if (measure_bytes > 0) {
+        text_width = lv_txt_get_width(content, measure_bytes, fonts_.text_font, 0);
+    }
+
+    // 确保文本宽度不小于最小宽度，且不超过最大宽度
+    if (text_width < min_width) {
+        text_width = min_width;
+    }
+    lv_coord_t bubble_width = text_width < max_width ? text_width : max_width;
+    lv_obj_set_width(slot.label, bubble_width);
 
     // Set alignment and style based on message role
     if (strcmp(role, "user") == 0) {
         // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme.assistant_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+        lv_obj_set_style_bg_color(slot.bubble, current_theme.user_bubble, 0);
+        lv_obj_set_style_text_color(slot.label, current_theme.text, 0);
+        lv_obj_set_user_data(slot.bubble, (void*)"user");
+        lv_obj_align(slot.bubble, LV_ALIGN_RIGHT_MID, -25, 0);
     } else if (strcmp(role, "system") == 0) {
         // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme.system_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+        lv_obj_set_style_bg_color(slot.bubble, current_theme.system_bubble, 0);
+        lv_obj_set_style_text_color(slot.label, current_theme.system_text, 0);
+        lv_obj_set_user_data(slot.bubble, (void*)"system");
+        lv_obj_align(slot.bubble, LV_ALIGN_CENTER, 0, 0);
     } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
-
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+        // Assistant messages are left-aligned with white background
+        lv_obj_set_style_bg_color(slot.bubble, current_theme.assistant_bubble, 0);
+        lv_obj_set_style_text_color(slot.label, current_theme.text, 0);
+        lv_obj_set_user_data(slot.bubble, (void*)"assistant");
+        lv_obj_align(slot.bubble, LV_ALIGN_LEFT_MID, 0, 0);
     }
-    
+    lv_obj_set_style_border_color(slot.bubble, current_theme.border, 0);
+
+    lv_obj_move_to_index(slot.row, -1);
+    lv_obj_clear_flag(slot.row, LV_OBJ_FLAG_HIDDEN);
+
+    // 自动滚动底部
+    lv_obj_scroll_to_view_recursive(slot.row, LV_ANIM_ON);
+
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = slot.label;
 }
 #else
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    SetupFlushStats();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
@@ -578,6 +708,9 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
     lv_obj_set_style_text_color(emotion_label_, current_theme.text, 0);
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
+    if (emotion_animation_.Load()) {
+        emotion_animation_.Attach(content_, emotion_label_);
+    }
 
     chat_message_label_ = lv_label_create(content_);
     lv_label_set_text(chat_message_label_, "");
@@ -636,7 +769,7 @@ void LcdDisplay::SetupUI() {
 }
 #endif
 
-void LcdDisplay::SetEmotion(const char* emotion) {
+void LcdDisplay::ApplyEmotion(const char* emotion) {
     struct Emotion {
         const char* icon;
         const char* text;
@@ -671,10 +804,13 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     auto it = std::find_if(emotions.begin(), emotions.end(),
         [&emotion_view](const Emotion& e) { return e.text == emotion_view; });
 
-    DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
     }
+    // 动画表情优先，没有对应的动画时显示静态表情
+    if (emotion_animation_.Play(emotion)) {
+        return;
+    }
 
     // 如果找到匹配的表情就显示对应图标，否则显示默认的neutral表情
     lv_obj_set_style_text_font(emotion_label_, fonts_.emoji_font, 0);
@@ -685,11 +821,11 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     }
 }
 
-void LcdDisplay::SetIcon(const char* icon) {
-    DisplayLockGuard lock(this);
+void LcdDisplay::ApplyIcon(const char* icon) {
     if (emotion_label_ == nullptr) {
         return;
     }
+    emotion_animation_.Stop();
     lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
     lv_label_set_text(emotion_label_, icon);
 }
@@ -2,12 +2,15 @@
 #define LCD_DISPLAY_H
 
 #include "display.h"
+#include "glyph_cache.h"
+#include "emotion_animation.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 #include <font_emoji.h>
 
 #include <atomic>
+#include <vector>
 
 class LcdDisplay : public Display {
 protected:
@@ -21,23 +24,56 @@ protected:
     lv_obj_t* side_bar_ = nullptr;
 
     DisplayFonts fonts_;
+    EmotionAnimation emotion_animation_;
+
+    // 刷屏统计
+    std::atomic<uint32_t> flush_count_ = 0;
+    std::atomic<uint32_t> flush_bytes_ = 0;
+    int64_t flush_stats_start_time_ = 0;
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 预先创建的消息气泡，循环复用
+    struct MessageSlot {
+        lv_obj_t* row = nullptr;
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        size_t text_bytes = 0;
+    };
+    std::vector<MessageSlot> message_slots_;
+    size_t next_message_slot_ = 0;
+    size_t message_text_bytes_ = 0;
+
+    void CreateMessageSlots();
+    void ReleaseMessageSlot(MessageSlot& slot);
+    void EvictMessageText(MessageSlot& keep, size_t incoming);
+#if CONFIG_CHAT_MESSAGE_BENCHMARK
+    void RunChatBenchmark();
+#endif
+#endif
 
     void SetupUI();
+    void SetupFlushStats();
+    virtual void Update() override;
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
+    virtual void ApplyEmotion(const char* emotion) override;
+    virtual void ApplyIcon(const char* icon) override;
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    virtual void ApplyChatMessage(const char* role, const char* content) override;
+    virtual void ApplyChatAppend(const char* role, const char* content, bool new_message) override;
+#endif
+
 protected:
     // 添加protected构造函数
     LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, DisplayFonts fonts)
-        : panel_io_(panel_io), panel_(panel), fonts_(fonts) {}
+        : panel_io_(panel_io), panel_(panel), fonts_(fonts) {
+        // 聊天文字使用压缩字体，缓存解压后的字形
+        fonts_.text_font = GlyphCache::GetInstance().Wrap(fonts.text_font);
+    }
     
 public:
     ~LcdDisplay();
-    virtual void SetEmotion(const char* emotion) override;
-    virtual void SetIcon(const char* icon) override;
-#if CONFIG_USE_WECHAT_MESSAGE_STYLE
-    virtual void SetChatMessage(const char* role, const char* content) override; 
-#endif  
 
     // Add theme switching function
     virtual void SetTheme(const std::string& theme_name) override;
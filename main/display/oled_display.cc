@@ -8,6 +8,8 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
 
 #define TAG "OledDisplay"
 
@@ -25,42 +27,50 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
     port_cfg.timer_period_ms = 50;
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD screen");
-    const lvgl_port_display_cfg_t display_cfg = {
-        .io_handle = panel_io_,
-        .panel_handle = panel_,
-        .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * height_),
-        .double_buffer = false,
-        .trans_size = 0,
-        .hres = static_cast<uint32_t>(width_),
-        .vres = static_cast<uint32_t>(height_),
-        .monochrome = true,
-        .rotation = {
-            .swap_xy = false,
-            .mirror_x = mirror_x,
-            .mirror_y = mirror_y,
-        },
-        .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
-            .sw_rotate = 0,
-            .full_refresh = 0,
-            .direct_mode = 0,
-        },
-    };
-
-    display_ = lvgl_port_add_disp(&display_cfg);
+    // 直接以 1bpp 渲染，刷新时只发送内容有变化的页（8 行）
+    ESP_LOGI(TAG, "Adding OLED screen");
+    ESP_ERROR_CHECK(esp_lcd_panel_mirror(panel_, mirror_x, mirror_y));
+    pages_ = (height_ + 7) / 8;
+    framebuffer_.assign(width_ * pages_, 0);
+    dirty_min_x_.assign(pages_, width_);
+    dirty_max_x_.assign(pages_, -1);
+
+    // I1 buffers start with an 8 byte palette
+    size_t buffer_size = 8 + (width_ + 7) / 8 * height_;
+    draw_buffer_ = (uint8_t*)heap_caps_malloc(buffer_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (draw_buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate draw buffer");
+        return;
+    }
+
+    lvgl_port_lock(0);
+    display_ = lv_display_create(width_, height_);
     if (display_ == nullptr) {
+        lvgl_port_unlock();
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    lv_display_set_color_format(display_, LV_COLOR_FORMAT_I1);
+    lv_display_set_buffers(display_, draw_buffer_, nullptr, buffer_size, LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_set_user_data(display_, this);
+    lv_display_set_flush_cb(display_, [](lv_display_t* disp, const lv_area_t* area, uint8_t* px_map) {
+        auto self = static_cast<OledDisplay*>(lv_display_get_user_data(disp));
+        self->Flush(area, px_map);
+        lv_display_flush_ready(disp);
+    });
+    lvgl_port_unlock();
+
+    // Clear the panel so that it matches the framebuffer
+    for (int page = 0; page < pages_; page++) {
+        esp_lcd_panel_draw_bitmap(panel_, 0, page * 8, width_, page * 8 + 8, &framebuffer_[page * width_]);
+    }
 
     if (height_ == 64) {
         SetupUI_128x64();
     } else {
         SetupUI_128x32();
     }
+    StartPendingTimer();
 }
 
 OledDisplay::~OledDisplay() {
@@ -77,6 +87,13 @@ OledDisplay::~OledDisplay() {
         lv_obj_del(container_);
     }
 
+    if (display_ != nullptr) {
+        lv_display_delete(display_);
+    }
+    if (draw_buffer_ != nullptr) {
+        heap_caps_free(draw_buffer_);
+    }
+
     if (panel_ != nullptr) {
         esp_lcd_panel_del(panel_);
     }
@@ -86,6 +103,70 @@ OledDisplay::~OledDisplay() {
     lvgl_port_deinit();
 }
 
+void OledDisplay::Flush(const lv_area_t* area, uint8_t* px_map) {
+    // Skip the palette of the I1 buffer
+    px_map += 8;
+    int area_width = lv_area_get_width(area);
+    int stride = (area_width + 7) / 8;
+
+    // 转换为 SSD1306 的页格式，同时记录每页实际变化的列范围
+    for (int y = area->y1; y <= area->y2 && y < height_; y++) {
+        const uint8_t* row = px_map + (y - area->y1) * stride;
+        int page = y / 8;
+        uint8_t mask = 1 << (y % 8);
+        uint8_t* column = &framebuffer_[page * width_];
+        for (int x = area->x1; x <= area->x2 && x < width_; x++) {
+            int i = x - area->x1;
+            // 暗色像素点亮，与 lvgl_port 的单色转换一致
+            bool on = !(row[i / 8] & (0x80 >> (i % 8)));
+            uint8_t value = on ? (column[x] | mask) : (column[x] & ~mask);
+            if (value != column[x]) {
+                column[x] = value;
+                if (x < dirty_min_x_[page]) {
+                    dirty_min_x_[page] = x;
+                }
+                if (x > dirty_max_x_[page]) {
+                    dirty_max_x_[page] = x;
+                }
+            }
+        }
+    }
+
+    if (!lv_display_flush_is_last(display_)) {
+        return;
+    }
+    for (int page = 0; page < pages_; page++) {
+        if (dirty_max_x_[page] < 0) {
+            continue;
+        }
+        int x1 = dirty_min_x_[page];
+        int x2 = dirty_max_x_[page] + 1;
+        esp_lcd_panel_draw_bitmap(panel_, x1, page * 8, x2, page * 8 + 8, &framebuffer_[page * width_ + x1]);
+        flush_bytes_ += x2 - x1;
+        dirty_min_x_[page] = width_;
+        dirty_max_x_[page] = -1;
+    }
+    flush_count_++;
+}
+
+#define FLUSH_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+void OledDisplay::Update() {
+    Display::Update();
+
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - flush_stats_start_time_;
+    if (elapsed < FLUSH_STATS_INTERVAL_US) {
+        return;
+    }
+    uint32_t count = flush_count_.exchange(0);
+    uint32_t bytes = flush_bytes_.exchange(0);
+    flush_stats_start_time_ = now;
+    if (count > 0) {
+        ESP_LOGI(TAG, "Flush: %.1f times/s, %.1f bytes/s", count * 1000000.0f / elapsed, bytes * 1000000.0f / elapsed);
+    }
+}
+
 bool OledDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -94,8 +175,7 @@ void OledDisplay::Unlock() {
     lvgl_port_unlock();
 }
 
-void OledDisplay::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
+void OledDisplay::ApplyChatMessage(const char* role, const char* content) {
     if (chat_message_label_ == nullptr) {
         return;
     }
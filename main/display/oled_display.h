@@ -6,6 +6,9 @@
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 
+#include <vector>
+#include <atomic>
+
 class OledDisplay : public Display {
 private:
     esp_lcd_panel_io_handle_t panel_io_ = nullptr;
@@ -20,9 +23,24 @@ private:
 
     DisplayFonts fonts_;
 
+    // 页格式的帧缓冲，每字节是一列中的 8 行，与 SSD1306 显存一致
+    std::vector<uint8_t> framebuffer_;
+    std::vector<int> dirty_min_x_;
+    std::vector<int> dirty_max_x_;
+    int pages_ = 0;
+    uint8_t* draw_buffer_ = nullptr;
+    std::atomic<uint32_t> flush_count_ = 0;
+    std::atomic<uint32_t> flush_bytes_ = 0;
+    int64_t flush_stats_start_time_ = 0;
+
+    void Flush(const lv_area_t* area, uint8_t* px_map);
+    virtual void Update() override;
+
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
+    virtual void ApplyChatMessage(const char* role, const char* content) override;
+
     void SetupUI_128x64();
     void SetupUI_128x32();
 
@@ -30,8 +48,6 @@ public:
     OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height, bool mirror_x, bool mirror_y,
                 DisplayFonts fonts);
     ~OledDisplay();
-
-    virtual void SetChatMessage(const char* role, const char* content) override;
 };
 
 #endif // OLED_DISPLAY_H
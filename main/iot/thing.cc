@@ -1,7 +1,7 @@
 #include "thing.h"
-#include "application.h"
 
 #include <esp_log.h>
+#include <algorithm>
 
 #define TAG "Thing"
 
@@ -26,6 +26,53 @@ Thing* CreateThing(const std::string& type) {
     return creator->second();
 }
 
+// FNV-1a
+uint32_t NameIndex::Hash(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (; *name != '\0'; name++) {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void NameIndex::Add(const std::string& name) {
+    if (Find(name.c_str()) >= 0) {
+        ESP_LOGW(TAG, "Duplicate name %s, keeping the first one", name.c_str());
+    }
+    names_.push_back(name);
+    Rebuild();
+}
+
+void NameIndex::Rebuild() {
+    // Start with a table twice the number of names, grow it if no seed is collision free
+    size_t size = 1;
+    while (size < names_.size() * 2) {
+        size <<= 1;
+    }
+    while (true) {
+        table_.assign(size, -1);
+        for (uint32_t seed = 0; seed < 64; seed++) {
+            bool collision = false;
+            for (size_t i = 0; i < names_.size() && !collision; i++) {
+                auto& slot = table_[Hash(names_[i].c_str(), seed) & (size - 1)];
+                if (slot >= 0) {
+                    // The same name always lands in the same slot, which stays with the first one
+                    collision = names_[slot] != names_[i];
+                } else {
+                    slot = i;
+                }
+            }
+            if (!collision) {
+                seed_ = seed;
+                return;
+            }
+            std::fill(table_.begin(), table_.end(), -1);
+        }
+        size <<= 1;
+    }
+}
+
 std::string Thing::GetDescriptorJson() {
     std::string json_str = "{";
     json_str += "\"name\":\"" + name_ + "\",";
@@ -44,32 +91,61 @@ std::string Thing::GetStateJson() {
     return json_str;
 }
 
-void Thing::Invoke(const cJSON* command) {
+bool Thing::GetDeltaStateJson(std::string& json) {
+    std::string state;
+    if (!properties_.GetDeltaStateJson(state)) {
+        return false;
+    }
+    json = "{\"name\":\"" + name_ + "\",\"state\":" + state + "}";
+    return true;
+}
+
+void Thing::NotifyPropertyChanged(const std::string& name) {
+    properties_.MarkChanged(name);
+    if (observer_) {
+        observer_(this, name);
+    }
+}
+
+Method* Thing::ParseCommand(const cJSON* command, ParameterList& parameters) {
     auto method_name = cJSON_GetObjectItem(command, "method");
     auto input_params = cJSON_GetObjectItem(command, "parameters");
+    if (!cJSON_IsString(method_name)) {
+        ESP_LOGE(TAG, "Invalid command for %s", name_.c_str());
+        return nullptr;
+    }
 
-    try {
-        auto& method = methods_[method_name->valuestring];
-        for (auto& param : method.parameters()) {
-            auto input_param = cJSON_GetObjectItem(input_params, param.name().c_str());
-            if (param.required() && input_param == nullptr) {
-                throw std::runtime_error("Parameter " + param.name() + " is required");
-            }
-            if (param.type() == kValueTypeNumber) {
-                param.set_number(input_param->valueint);
-            } else if (param.type() == kValueTypeString) {
-                param.set_string(input_param->valuestring);
-            } else if (param.type() == kValueTypeBoolean) {
-                param.set_boolean(input_param->valueint == 1);
+    auto method = methods_.Find(method_name->valuestring);
+    if (method == nullptr) {
+        ESP_LOGE(TAG, "Method not found: %s", method_name->valuestring);
+        return nullptr;
+    }
+    parameters = method->parameters();
+    for (auto& param : parameters) {
+        auto input_param = cJSON_GetObjectItem(input_params, param.name().c_str());
+        if (input_param == nullptr) {
+            if (param.required()) {
+                ESP_LOGE(TAG, "Parameter %s is required", param.name().c_str());
+                return nullptr;
             }
+            continue;
         }
+        if (param.type() == kValueTypeNumber) {
+            param.set_number(input_param->valueint);
+        } else if (param.type() == kValueTypeString) {
+            param.set_string(cJSON_IsString(input_param) ? input_param->valuestring : "");
+        } else if (param.type() == kValueTypeBoolean) {
+            param.set_boolean(input_param->valueint == 1);
+        }
+    }
+    return method;
+}
 
-        Application::GetInstance().Schedule([&method]() {
-            method.Invoke();
-        });
-    } catch (const std::runtime_error& e) {
-        ESP_LOGE(TAG, "Method not found: %s", method_name->valuestring);
-        return;
+void Thing::Invoke(const cJSON* command) {
+    ParameterList parameters;
+    auto method = ParseCommand(command, parameters);
+    if (method != nullptr) {
+        method->Invoke(parameters);
     }
 }
 
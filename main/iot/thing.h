@@ -6,10 +6,39 @@
 #include <functional>
 #include <vector>
 #include <stdexcept>
+#include <atomic>
 #include <cJSON.h>
 
 namespace iot {
 
+// Index from name to position, built when names are registered.
+// A perfect hash is searched so that a lookup is one hash and one string compare.
+class NameIndex {
+private:
+    std::vector<std::string> names_;
+    std::vector<int16_t> table_;
+    uint32_t seed_ = 0;
+
+    static uint32_t Hash(const char* name, uint32_t seed);
+    void Rebuild();
+
+public:
+    // A duplicate name keeps its position but lookups return the first one
+    void Add(const std::string& name);
+
+    // Returns -1 if the name is not registered
+    int Find(const char* name) const {
+        if (table_.empty()) {
+            return -1;
+        }
+        int index = table_[Hash(name, seed_) & (table_.size() - 1)];
+        if (index < 0 || names_[index] != name) {
+            return -1;
+        }
+        return index;
+    }
+};
+
 enum ValueType {
     kValueTypeBoolean,
     kValueTypeNumber,
@@ -25,6 +54,28 @@ private:
     std::function<int()> number_getter_;
     std::function<std::string()> string_getter_;
 
+    // 变化跟踪：owner 调用 MarkChanged 后只在标记时读取，否则比较值的哈希。
+    // MarkChanged 在方法执行的任务中调用，HasChanged 在主循环和网络任务中调用
+    std::atomic<bool> tracked_ = false;
+    std::atomic<bool> dirty_ = true;
+    std::atomic<bool> reported_ = false;
+    std::atomic<uint32_t> reported_hash_ = 0;
+
+    uint32_t GetValueHash() const {
+        if (type_ == kValueTypeBoolean) {
+            return boolean_getter_() ? 1 : 0;
+        } else if (type_ == kValueTypeNumber) {
+            return (uint32_t)number_getter_();
+        }
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (auto c : string_getter_()) {
+            hash ^= (uint8_t)c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
 public:
     Property(const std::string& name, const std::string& description, std::function<bool()> getter) :
         name_(name), description_(description), type_(kValueTypeBoolean), boolean_getter_(getter) {}
@@ -32,6 +83,11 @@ public:
         name_(name), description_(description), type_(kValueTypeNumber), number_getter_(getter) {}
     Property(const std::string& name, const std::string& description, std::function<std::string()> getter) :
         name_(name), description_(description), type_(kValueTypeString), string_getter_(getter) {}
+    Property(const Property& other) :
+        name_(other.name_), description_(other.description_), type_(other.type_),
+        boolean_getter_(other.boolean_getter_), number_getter_(other.number_getter_), string_getter_(other.string_getter_),
+        tracked_(other.tracked_.load()), dirty_(other.dirty_.load()), reported_(other.reported_.load()),
+        reported_hash_(other.reported_hash_.load()) {}
 
     const std::string& name() const { return name_; }
     const std::string& description() const { return description_; }
@@ -55,6 +111,34 @@ public:
         return json_str;
     }
 
+    void MarkChanged() {
+        tracked_ = true;
+        dirty_ = true;
+    }
+
+    // Returns true if the value differs from the last reported one, without building the JSON
+    bool HasChanged() {
+        // The flag is cleared before the value is read, so a change marked meanwhile is not lost
+        bool dirty = dirty_.exchange(false);
+        if (tracked_ && !dirty) {
+            return false;
+        }
+        uint32_t hash = GetValueHash();
+        if (reported_ && hash == reported_hash_) {
+            return false;
+        }
+        reported_hash_ = hash;
+        reported_ = true;
+        return true;
+    }
+
+    // Take the current value as reported, used when the full state is sent
+    void ResetChanged() {
+        dirty_ = false;
+        reported_hash_ = GetValueHash();
+        reported_ = true;
+    }
+
     std::string GetStateJson() {
         if (type_ == kValueTypeBoolean) {
             return boolean_getter_() ? "true" : "false";
@@ -70,28 +154,41 @@ public:
 class PropertyList {
 private:
     std::vector<Property> properties_;
+    NameIndex index_;
 
 public:
     PropertyList() = default;
-    PropertyList(const std::vector<Property>& properties) : properties_(properties) {}
+    PropertyList(const std::vector<Property>& properties) : properties_(properties) {
+        for (auto& property : properties_) {
+            index_.Add(property.name());
+        }
+    }
 
     void AddBooleanProperty(const std::string& name, const std::string& description, std::function<bool()> getter) {
         properties_.push_back(Property(name, description, getter));
+        index_.Add(name);
     }
     void AddNumberProperty(const std::string& name, const std::string& description, std::function<int()> getter) {
         properties_.push_back(Property(name, description, getter));
+        index_.Add(name);
     }
     void AddStringProperty(const std::string& name, const std::string& description, std::function<std::string()> getter) {
         properties_.push_back(Property(name, description, getter));
+        index_.Add(name);
+    }
+
+    // Returns nullptr if the property does not exist
+    Property* Find(const char* name) {
+        int index = index_.Find(name);
+        return index < 0 ? nullptr : &properties_[index];
     }
 
     const Property& operator[](const std::string& name) const {
-        for (auto& property : properties_) {
-            if (property.name() == name) {
-                return property;
-            }
+        int index = index_.Find(name.c_str());
+        if (index < 0) {
+            throw std::runtime_error("Property not found: " + name);
         }
-        throw std::runtime_error("Property not found: " + name);
+        return properties_[index];
     }
 
     std::string GetDescriptorJson() {
@@ -106,9 +203,17 @@ public:
         return json_str;
     }
 
+    void MarkChanged(const std::string& name) {
+        auto property = Find(name.c_str());
+        if (property != nullptr) {
+            property->MarkChanged();
+        }
+    }
+
     std::string GetStateJson() {
         std::string json_str = "{";
         for (auto& property : properties_) {
+            property.ResetChanged();
             json_str += "\"" + property.name() + "\":" + property.GetStateJson() + ",";
         }
         if (json_str.back() == ',') {
@@ -117,6 +222,21 @@ public:
         json_str += "}";
         return json_str;
     }
+
+    // Only the properties changed since the last report, returns false if there is none
+    bool GetDeltaStateJson(std::string& json_str) {
+        json_str = "{";
+        for (auto& property : properties_) {
+            if (property.HasChanged()) {
+                json_str += "\"" + property.name() + "\":" + property.GetStateJson() + ",";
+            }
+        }
+        if (json_str.back() != ',') {
+            return false;
+        }
+        json_str.back() = '}';
+        return true;
+    }
 };
 
 class Parameter {
@@ -164,21 +284,32 @@ public:
 class ParameterList {
 private:
     std::vector<Parameter> parameters_;
+    NameIndex index_;
 
 public:
     ParameterList() = default;
-    ParameterList(const std::vector<Parameter>& parameters) : parameters_(parameters) {}
+    ParameterList(const std::vector<Parameter>& parameters) : parameters_(parameters) {
+        for (auto& parameter : parameters_) {
+            index_.Add(parameter.name());
+        }
+    }
     void AddParameter(const Parameter& parameter) {
         parameters_.push_back(parameter);
+        index_.Add(parameter.name());
+    }
+
+    // Returns nullptr if the parameter does not exist
+    const Parameter* Find(const char* name) const {
+        int index = index_.Find(name);
+        return index < 0 ? nullptr : &parameters_[index];
     }
 
     const Parameter& operator[](const std::string& name) const {
-        for (auto& parameter : parameters_) {
-            if (parameter.name() == name) {
-                return parameter;
-            }
+        int index = index_.Find(name.c_str());
+        if (index < 0) {
+            throw std::runtime_error("Parameter not found: " + name);
         }
-        throw std::runtime_error("Parameter not found: " + name);
+        return parameters_[index];
     }
 
     // iterator
@@ -204,14 +335,19 @@ private:
     std::string description_;
     ParameterList parameters_;
     std::function<void(const ParameterList&)> callback_;
+    bool main_task_;
 
 public:
-    Method(const std::string& name, const std::string& description, const ParameterList& parameters, std::function<void(const ParameterList&)> callback) :
-        name_(name), description_(description), parameters_(parameters), callback_(callback) {}
+    // main_task: the callback touches state owned by the main task (audio codec, display,
+    // LEDs following the device state), the executor runs it there instead of on its worker
+    Method(const std::string& name, const std::string& description, const ParameterList& parameters,
+        std::function<void(const ParameterList&)> callback, bool main_task = false) :
+        name_(name), description_(description), parameters_(parameters), callback_(callback), main_task_(main_task) {}
 
     const std::string& name() const { return name_; }
     const std::string& description() const { return description_; }
     ParameterList& parameters() { return parameters_; }
+    bool main_task() const { return main_task_; }
 
     std::string GetDescriptorJson() {
         std::string json_str = "{";
@@ -224,27 +360,43 @@ public:
     void Invoke() {
         callback_(parameters_);
     }
+
+    void Invoke(const ParameterList& parameters) {
+        callback_(parameters);
+    }
 };
 
 class MethodList {
 private:
     std::vector<Method> methods_;
+    NameIndex index_;
 
 public:
     MethodList() = default;
-    MethodList(const std::vector<Method>& methods) : methods_(methods) {}
+    MethodList(const std::vector<Method>& methods) : methods_(methods) {
+        for (auto& method : methods_) {
+            index_.Add(method.name());
+        }
+    }
+
+    void AddMethod(const std::string& name, const std::string& description, const ParameterList& parameters,
+        std::function<void(const ParameterList&)> callback, bool main_task = false) {
+        methods_.push_back(Method(name, description, parameters, callback, main_task));
+        index_.Add(name);
+    }
 
-    void AddMethod(const std::string& name, const std::string& description, const ParameterList& parameters, std::function<void(const ParameterList&)> callback) {
-        methods_.push_back(Method(name, description, parameters, callback));
+    // Returns nullptr if the method does not exist
+    Method* Find(const char* name) {
+        int index = index_.Find(name);
+        return index < 0 ? nullptr : &methods_[index];
     }
 
     Method& operator[](const std::string& name) {
-        for (auto& method : methods_) {
-            if (method.name() == name) {
-                return method;
-            }
+        int index = index_.Find(name.c_str());
+        if (index < 0) {
+            throw std::runtime_error("Method not found: " + name);
         }
-        throw std::runtime_error("Method not found: " + name);
+        return methods_[index];
     }
 
     std::string GetDescriptorJson() {
@@ -268,11 +420,19 @@ public:
 
     virtual std::string GetDescriptorJson();
     virtual std::string GetStateJson();
+    virtual bool GetDeltaStateJson(std::string& json);
     virtual void Invoke(const cJSON* command);
+    // Find the method of the command and fill a copy of its parameters, returns nullptr on error
+    Method* ParseCommand(const cJSON* command, ParameterList& parameters);
 
     const std::string& name() const { return name_; }
     const std::string& description() const { return description_; }
 
+    // Called by the owner when the value of a property changes. The property is then
+    // only read when marked, instead of being polled, and the observer is notified.
+    void NotifyPropertyChanged(const std::string& name);
+    void OnPropertyChanged(std::function<void(Thing* thing, const std::string& name)> observer) { observer_ = observer; }
+
 protected:
     PropertyList properties_;
     MethodList methods_;
@@ -280,6 +440,7 @@ protected:
 private:
     std::string name_;
     std::string description_;
+    std::function<void(Thing* thing, const std::string& name)> observer_;
 };
 
 
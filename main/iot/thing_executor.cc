@@ -0,0 +1,124 @@
+#include "thing_executor.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "ThingExecutor"
+
+namespace iot {
+
+ThingExecutor::ThingExecutor() {
+}
+
+ThingExecutor::~ThingExecutor() {
+    if (task_ != nullptr) {
+        vTaskDelete(task_);
+    }
+}
+
+void ThingExecutor::OnResult(std::function<void(const ThingCommand& command, const char* status)> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    on_result_ = callback;
+}
+
+void ThingExecutor::SetScheduler(std::function<void(std::function<void()> callback)> scheduler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduler_ = scheduler;
+}
+
+void ThingExecutor::Submit(ThingCommand&& command) {
+    bool superseded = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (task_ == nullptr) {
+            xTaskCreate([](void* arg) {
+                auto executor = static_cast<ThingExecutor*>(arg);
+                executor->WorkerLoop();
+            }, "thing_worker", 4096, this, 3, &task_);
+        }
+        auto& queue = queues_[command.thing];
+        for (auto& queued : queue) {
+            if (queued.method == command.method) {
+                // Only the latest value matters, e.g. repeated SetVolume
+                std::swap(queued, command);
+                superseded = true;
+                break;
+            }
+        }
+        if (!superseded) {
+            queue.push_back(std::move(command));
+        }
+    }
+    condition_variable_.notify_one();
+
+    if (superseded) {
+        ESP_LOGI(TAG, "%s.%s superseded", command.thing->name().c_str(), command.method->name().c_str());
+        Report(command, "superseded");
+    }
+}
+
+void ThingExecutor::Report(const ThingCommand& command, const char* status) {
+    // The callback may take other locks, so it is called without holding mutex_
+    std::function<void(const ThingCommand& command, const char* status)> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback = on_result_;
+    }
+    if (callback) {
+        callback(command, status);
+    }
+}
+
+bool ThingExecutor::PopNext(ThingCommand& command) {
+    // Round robin over the things, starting after the one served last
+    auto it = queues_.upper_bound(last_thing_);
+    for (size_t i = 0; i < queues_.size(); i++, it++) {
+        if (it == queues_.end()) {
+            it = queues_.begin();
+        }
+        if (!it->second.empty()) {
+            command = std::move(it->second.front());
+            it->second.pop_front();
+            last_thing_ = it->first;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThingExecutor::Run(ThingCommand& command) {
+    std::function<void(std::function<void()> callback)> scheduler;
+    if (command.method->main_task()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        scheduler = scheduler_;
+    }
+    if (!scheduler) {
+        command.method->Invoke(command.parameters);
+        return;
+    }
+    // Wait for the main task, so that the result and the next command follow the method
+    TaskHandle_t worker = xTaskGetCurrentTaskHandle();
+    scheduler([&command, worker]() {
+        command.method->Invoke(command.parameters);
+        xTaskNotifyGive(worker);
+    });
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void ThingExecutor::WorkerLoop() {
+    while (true) {
+        ThingCommand command;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_variable_.wait(lock, [this, &command]() { return PopNext(command); });
+        }
+
+        auto start_time = esp_timer_get_time();
+        Run(command);
+        ESP_LOGI(TAG, "%s.%s done in %lld ms", command.thing->name().c_str(), command.method->name().c_str(),
+            (esp_timer_get_time() - start_time) / 1000);
+        Report(command, "done");
+    }
+}
+
+} // namespace iot
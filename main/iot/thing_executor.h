@@ -0,0 +1,59 @@
+#ifndef THING_EXECUTOR_H
+#define THING_EXECUTOR_H
+
+#include "thing.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace iot {
+
+struct ThingCommand {
+    Thing* thing;
+    Method* method;
+    ParameterList parameters;
+    // Optional id given by the server, echoed in the result
+    std::string id;
+};
+
+// Runs IoT commands off the network thread on a single worker task. Every thing
+// has its own queue and the worker takes from the queues in turn, so commands of a
+// thing run in order and a thing with many queued commands does not starve the others.
+// A queued command is replaced by a newer command for the same method.
+// Methods marked main_task are handed to the scheduler and the worker waits for them.
+class ThingExecutor {
+public:
+    ThingExecutor();
+    ~ThingExecutor();
+
+    void Submit(ThingCommand&& command);
+    // status is "done" or "superseded"
+    void OnResult(std::function<void(const ThingCommand& command, const char* status)> callback);
+    // Runs a callback on the main task, without one main_task methods run on the worker
+    void SetScheduler(std::function<void(std::function<void()> callback)> scheduler);
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_variable_;
+    std::map<Thing*, std::deque<ThingCommand>> queues_;
+    // The thing served last, the next command is taken from the queue after it
+    Thing* last_thing_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    std::function<void(const ThingCommand& command, const char* status)> on_result_;
+    std::function<void(std::function<void()> callback)> scheduler_;
+
+    bool PopNext(ThingCommand& command);
+    void Report(const ThingCommand& command, const char* status);
+    void Run(ThingCommand& command);
+    void WorkerLoop();
+};
+
+} // namespace iot
+
+#endif // THING_EXECUTOR_H
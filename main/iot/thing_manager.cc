@@ -4,16 +4,81 @@
 
 #define TAG "ThingManager"
 
+// Changes within this interval are sent together in one message
+#define IOT_STATES_DEBOUNCE_MS 500
+
 namespace iot {
 
+ThingManager::ThingManager() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<ThingManager*>(arg);
+            if (self->on_states_changed_) {
+                self->on_states_changed_();
+            }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "iot_states_changed",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&timer_args, &states_changed_timer_);
+}
+
+ThingManager::~ThingManager() {
+    if (states_changed_timer_ != nullptr) {
+        esp_timer_stop(states_changed_timer_);
+        esp_timer_delete(states_changed_timer_);
+    }
+}
+
+void ThingManager::OnStatesChanged(std::function<void()> callback) {
+    on_states_changed_ = callback;
+}
+
+void ThingManager::NotifyPropertyChanged(const char* thing, const char* property) {
+    int index = thing_index_.Find(thing);
+    if (index >= 0) {
+        things_[index]->NotifyPropertyChanged(property);
+    }
+}
+
 void ThingManager::AddThing(Thing* thing) {
+    thing->OnPropertyChanged([this](Thing* thing, const std::string& name) {
+        // The first change starts the interval, later ones are batched into it
+        if (!esp_timer_is_active(states_changed_timer_)) {
+            esp_timer_start_once(states_changed_timer_, IOT_STATES_DEBOUNCE_MS * 1000);
+        }
+    });
     things_.push_back(thing);
+    thing_index_.Add(thing->name());
+    descriptors_.clear();
+}
+
+const std::vector<std::string>& ThingManager::GetDescriptors() {
+    if (descriptors_.size() != things_.size()) {
+        descriptors_.clear();
+        descriptors_.reserve(things_.size());
+        for (auto& thing : things_) {
+            descriptors_.push_back(thing->GetDescriptorJson());
+            descriptors_.back().shrink_to_fit();
+        }
+    }
+    return descriptors_;
 }
 
 std::string ThingManager::GetDescriptorsJson() {
-    std::string json_str = "[";
-    for (auto& thing : things_) {
-        json_str += thing->GetDescriptorJson() + ",";
+    auto& descriptors = GetDescriptors();
+    size_t size = 2;
+    for (auto& descriptor : descriptors) {
+        size += descriptor.size() + 1;
+    }
+    std::string json_str;
+    json_str.reserve(size);
+    json_str = "[";
+    for (auto& descriptor : descriptors) {
+        json_str += descriptor;
+        json_str += ",";
     }
     if (json_str.back() == ',') {
         json_str.pop_back();
@@ -23,25 +88,21 @@ std::string ThingManager::GetDescriptorsJson() {
 }
 
 bool ThingManager::GetStatesJson(std::string& json, bool delta) {
-    if (!delta) {
-        last_states_.clear();
-    }
+    // 完整状态会重置每个属性的已上报值；delta 只包含变化的属性
     bool changed = false;
     json = "[";
-    // 枚举thing，获取每个thing的state，如果发生变化，则更新，保存到last_states_
-    // 如果delta为true，则只返回变化的部分
+    std::string state;
     for (auto& thing : things_) {
-        std::string state = thing->GetStateJson();
         if (delta) {
-            // 如果delta为true，则只返回变化的部分
-            auto it = last_states_.find(thing->name());
-            if (it != last_states_.end() && it->second == state) {
+            if (!thing->GetDeltaStateJson(state)) {
                 continue;
             }
-            changed = true;
-            last_states_[thing->name()] = state;
+        } else {
+            state = thing->GetStateJson();
         }
-        json += state + ",";
+        changed = true;
+        json += state;
+        json += ",";
     }
     if (json.back() == ',') {
         json.pop_back();
@@ -52,12 +113,44 @@ bool ThingManager::GetStatesJson(std::string& json, bool delta) {
 
 void ThingManager::Invoke(const cJSON* command) {
     auto name = cJSON_GetObjectItem(command, "name");
-    for (auto& thing : things_) {
-        if (thing->name() == name->valuestring) {
-            thing->Invoke(command);
-            return;
-        }
+    if (!cJSON_IsString(name)) {
+        ESP_LOGE(TAG, "Invalid IoT command");
+        return;
     }
+    int index = thing_index_.Find(name->valuestring);
+    if (index < 0) {
+        ESP_LOGE(TAG, "Thing not found: %s", name->valuestring);
+        return;
+    }
+    auto thing = things_[index];
+
+    ThingCommand thing_command;
+    thing_command.thing = thing;
+    thing_command.method = thing->ParseCommand(command, thing_command.parameters);
+    if (thing_command.method == nullptr) {
+        return;
+    }
+    auto id = cJSON_GetObjectItem(command, "id");
+    if (cJSON_IsString(id)) {
+        thing_command.id = id->valuestring;
+    }
+    executor_.Submit(std::move(thing_command));
+}
+
+void ThingManager::SetMainTaskScheduler(std::function<void(std::function<void()> callback)> scheduler) {
+    executor_.SetScheduler(scheduler);
+}
+
+void ThingManager::OnInvokeResult(std::function<void(const std::string& result)> callback) {
+    executor_.OnResult([callback](const ThingCommand& command, const char* status) {
+        std::string result = "{\"name\":\"" + command.thing->name() + "\",\"method\":\"" + command.method->name() +
+            "\",\"status\":\"" + status + "\"";
+        if (!command.id.empty()) {
+            result += ",\"id\":\"" + command.id + "\"";
+        }
+        result += "}";
+        callback(result);
+    });
 }
 
 } // namespace iot
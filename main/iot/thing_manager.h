@@ -3,8 +3,10 @@
 
 
 #include "thing.h"
+#include "thing_executor.h"
 
 #include <cJSON.h>
+#include <esp_timer.h>
 
 #include <vector>
 #include <memory>
@@ -24,16 +26,32 @@ public:
 
     void AddThing(Thing* thing);
 
+    // Descriptor of each thing, serialized once and kept until a thing is added
+    const std::vector<std::string>& GetDescriptors();
     std::string GetDescriptorsJson();
     bool GetStatesJson(std::string& json, bool delta = false);
+    // Publish a property change of a registered thing, ignored if the thing is not registered
+    void NotifyPropertyChanged(const char* thing, const char* property);
+    // Called once per debounce interval after properties changed, to push the delta states
+    void OnStatesChanged(std::function<void()> callback);
+
+    // Queue the command to the executor of the thing, it runs off the calling thread
     void Invoke(const cJSON* command);
+    // Called with the result JSON of every command: {"name","method","status"[,"id"]}
+    void OnInvokeResult(std::function<void(const std::string& result)> callback);
+    // Used to run the methods that must not leave the main task, see Method
+    void SetMainTaskScheduler(std::function<void(std::function<void()> callback)> scheduler);
 
 private:
-    ThingManager() = default;
-    ~ThingManager() = default;
+    ThingManager();
+    ~ThingManager();
 
     std::vector<Thing*> things_;
-    std::map<std::string, std::string> last_states_;
+    NameIndex thing_index_;
+    ThingExecutor executor_;
+    esp_timer_handle_t states_changed_timer_ = nullptr;
+    std::function<void()> on_states_changed_;
+    std::vector<std::string> descriptors_;
 };
 
 
@@ -4,6 +4,7 @@
 
 #include <driver/gpio.h>
 #include <esp_log.h>
+#include <atomic>
 
 #define TAG "Lamp"
 
@@ -17,7 +18,8 @@ private:
 #else
     gpio_num_t gpio_num_ = GPIO_NUM_18;
 #endif
-    bool power_ = false;
+    // Set by the thing worker, read when the states are reported
+    std::atomic<bool> power_ = false;
 
     void InitializeGpio() {
         gpio_config_t config = {
@@ -1,4 +1,5 @@
 #include "iot/thing.h"
+#include "iot/thing_manager.h"
 #include "board.h"
 #include "display/lcd_display.h"
 #include "settings.h"
@@ -34,8 +35,9 @@ public:
             auto display = Board::GetInstance().GetDisplay();
             if (display) {
                 display->SetTheme(theme_name);
+                ThingManager::GetInstance().NotifyPropertyChanged("Screen", "theme");
             }
-        });
+        }, true);
         
         methods_.AddMethod("SetBrightness", "设置亮度", ParameterList({
             Parameter("brightness", "0到100之间的整数", kValueTypeNumber, true)
@@ -45,7 +47,7 @@ public:
             if (backlight) {
                 backlight->SetBrightness(brightness, true);
             }
-        });
+        }, true);
     }
 };
 
@@ -24,7 +24,7 @@ public:
         }), [this](const ParameterList& parameters) {
             auto codec = Board::GetInstance().GetAudioCodec();
             codec->SetOutputVolume(static_cast<uint8_t>(parameters["volume"].number()));
-        });
+        }, true);
     }
 };
 
@@ -1,4 +1,6 @@
 #include "ota.h"
+#include "ota_patch.h"
+#include "ota_writer.h"
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
@@ -21,6 +23,11 @@
 
 #define TAG "Ota"
 
+// Consecutive failures without progress before the download is given up
+#define OTA_MAX_RETRIES 5
+// Larger responses are not cached, NVS strings are limited to 4000 bytes
+#define OTA_CACHED_RESPONSE_MAX_SIZE 3072
+
 
 Ota::Ota() {
     SetCheckVersionUrl(CONFIG_OTA_VERSION_URL);
@@ -84,6 +91,17 @@ bool Ota::CheckVersion() {
 
     auto http = SetupHttp();
 
+    // The server answers 304 if the response is the same as the cached one
+    Settings settings("ota", true);
+    std::string cached_response;
+    if (settings.GetString("version") == current_version_) {
+        cached_response = settings.GetString("response");
+        std::string etag = settings.GetString("etag");
+        if (!cached_response.empty() && !etag.empty()) {
+            http->SetHeader("If-None-Match", etag);
+        }
+    }
+
     std::string data = board.GetJson();
     std::string method = data.length() > 0 ? "POST" : "GET";
     if (!http->Open(method, check_version_url_, data)) {
@@ -92,13 +110,69 @@ bool Ota::CheckVersion() {
         return false;
     }
 
-    data = http->GetBody();
+    bool not_modified = http->GetStatusCode() == 304 && !cached_response.empty();
+    std::string etag;
+    if (not_modified) {
+        // The cached response has no server time, so a stale timestamp is never set on the clock
+        ESP_LOGI(TAG, "Config not modified, using cached response");
+        data = std::move(cached_response);
+    } else {
+        data = http->GetBody();
+        etag = http->GetResponseHeader("ETag");
+    }
     delete http;
 
-    // Response: { "firmware": { "version": "1.0.0", "url": "http://" } }
-    // Parse the JSON response and check if the version is newer
-    // If it is, set has_new_version_ to true and store the new version and URL
-    
+    if (!ParseResponse(data, false)) {
+        return false;
+    }
+
+    if (!not_modified) {
+        // The server time is only right at the moment of this response, the clock is set from fresh responses only
+        cJSON *root = cJSON_Parse(data.c_str());
+        if (root != NULL) {
+            cJSON_DeleteItemFromObject(root, "server_time");
+            char *json = cJSON_PrintUnformatted(root);
+            if (json != NULL) {
+                data = json;
+                cJSON_free(json);
+            }
+            cJSON_Delete(root);
+        }
+
+        // Activation responses are only valid once, they are never used from the cache
+        if (!has_activation_code_ && !has_activation_challenge_ && data.size() <= OTA_CACHED_RESPONSE_MAX_SIZE) {
+            settings.SetString("response", data);
+            settings.SetString("etag", etag);
+            settings.SetString("version", current_version_);
+        } else {
+            settings.EraseKey("response");
+            settings.EraseKey("etag");
+        }
+    }
+    return true;
+}
+
+bool Ota::LoadCachedConfig() {
+    current_version_ = esp_app_get_description()->version;
+
+    // The cache is dropped after an upgrade, the first boot of a new version checks with the server
+    Settings settings("ota", false);
+    if (settings.GetString("version") != current_version_) {
+        return false;
+    }
+    std::string data = settings.GetString("response");
+    if (data.empty() || !ParseResponse(data, true)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Loaded cached config, firmware version %s", firmware_version_.c_str());
+    return true;
+}
+
+// Response: { "firmware": { "version": "1.0.0", "url": "http://" } }
+// Parse the JSON response and check if the version is newer
+// If it is, set has_new_version_ to true and store the new version and URL
+// A cached response only restores the config, the server time and upgrades need a fresh one
+bool Ota::ParseResponse(const std::string& data, bool cached) {
     cJSON *root = cJSON_Parse(data.c_str());
     if (root == NULL) {
         ESP_LOGE(TAG, "Failed to parse JSON response");
@@ -138,6 +212,7 @@ bool Ota::CheckVersion() {
             if (item->type == cJSON_String) {
                 if (settings.GetString(item->string) != item->valuestring) {
                     settings.SetString(item->string, item->valuestring);
+                    mqtt_config_changed_ = true;
                 }
             }
         }
@@ -146,7 +221,7 @@ bool Ota::CheckVersion() {
 
     has_server_time_ = false;
     cJSON *server_time = cJSON_GetObjectItem(root, "server_time");
-    if (server_time != NULL) {
+    if (server_time != NULL && !cached) {
         cJSON *timestamp = cJSON_GetObjectItem(server_time, "timestamp");
         cJSON *timezone_offset = cJSON_GetObjectItem(server_time, "timezone_offset");
         
@@ -178,6 +253,21 @@ bool Ota::CheckVersion() {
         if (url != NULL) {
             firmware_url_ = url->valuestring;
         }
+        firmware_sha256_.clear();
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        if (cJSON_IsString(sha256)) {
+            firmware_sha256_ = sha256->valuestring;
+        }
+        // Optional delta patch against the running version: { "from": "1.0.0", "url": "http://" }
+        patch_url_.clear();
+        cJSON *patch = cJSON_GetObjectItem(firmware, "patch");
+        if (patch != NULL) {
+            cJSON *from = cJSON_GetObjectItem(patch, "from");
+            cJSON *patch_url = cJSON_GetObjectItem(patch, "url");
+            if (cJSON_IsString(from) && cJSON_IsString(patch_url) && current_version_ == from->valuestring) {
+                patch_url_ = patch_url->valuestring;
+            }
+        }
 
         if (version != NULL && url != NULL) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -194,10 +284,19 @@ bool Ota::CheckVersion() {
             }
         }
     }
+    if (cached) {
+        has_new_version_ = false;
+    }
     cJSON_Delete(root);
     return true;
 }
 
+bool Ota::TakeMqttConfigChanged() {
+    bool changed = mqtt_config_changed_;
+    mqtt_config_changed_ = false;
+    return changed;
+}
+
 void Ota::MarkCurrentVersionValid() {
     auto partition = esp_ota_get_running_partition();
     if (strcmp(partition->label, "factory") == 0) {
@@ -218,97 +317,197 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-void Ota::Upgrade(const std::string& firmware_url) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
-    esp_ota_handle_t update_handle = 0;
-    auto update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "Failed to get update partition");
-        return;
+bool Ota::CheckImageHeader(const uint8_t* data, size_t size) {
+    if (size < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+        ESP_LOGE(TAG, "Firmware image is too small");
+        return false;
     }
+    esp_app_desc_t new_app_info;
+    memcpy(&new_app_info, data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+    ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
 
-    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
-
-    auto http = Board::GetInstance().CreateHttp();
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        delete http;
-        return;
+    auto current_version = esp_app_get_description()->version;
+    if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
+        ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
+        return false;
     }
+    return true;
+}
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        delete http;
-        return;
-    }
+bool Ota::Download(const std::string& url, const std::function<uint8_t*()>& get_buffer,
+    const std::function<bool(uint8_t* buffer, size_t size)>& submit) {
+    // Network reads fill a buffer while the previous one is being processed.
+    // A dropped connection resumes from the received offset with a Range request.
+    uint8_t* buffer = nullptr;
+    size_t filled = 0;
+    size_t total_read = 0, recent_read = 0, content_length = 0;
+    int failures = 0;
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+
+    bool completed = false;
+    while (!completed) {
+        if (failures > OTA_MAX_RETRIES) {
+            ESP_LOGE(TAG, "Too many download failures, giving up");
+            return false;
+        }
+        if (failures > 0) {
+            vTaskDelay(pdMS_TO_TICKS(1000 * failures));
+        }
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+        auto http = Board::GetInstance().CreateHttp();
+        if (total_read > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(total_read) + "-");
+            ESP_LOGI(TAG, "Resuming download at %zu", total_read);
+        }
+        if (!http->Open("GET", url)) {
+            ESP_LOGE(TAG, "Failed to open HTTP connection");
             delete http;
-            return;
+            failures++;
+            continue;
         }
 
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %zu%% (%zu/%zu), Speed: %zuB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
-            }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
+        int status_code = http->GetStatusCode();
+        size_t skip = 0;
+        if (status_code == 206) {
+            content_length = total_read + http->GetBodyLength();
+        } else if (status_code == 200) {
+            // The server ignored the Range header, skip what we already have
+            skip = total_read;
+            content_length = http->GetBodyLength();
+        } else {
+            ESP_LOGE(TAG, "Unexpected HTTP status: %d", status_code);
+            delete http;
+            failures++;
+            continue;
         }
-
-        if (ret == 0) {
-            break;
+        if (content_length == 0) {
+            ESP_LOGE(TAG, "Failed to get content length");
+            delete http;
+            return false;
         }
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
+        bool progressed = false;
+        while (true) {
+            if (buffer == nullptr) {
+                buffer = get_buffer();
+            }
+            size_t to_read = OTA_WRITER_BUFFER_SIZE - filled;
+            if (skip > 0 && skip < to_read) {
+                to_read = skip;
+            }
+            int ret = http->Read((char*)buffer + filled, to_read);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                break;
+            }
+            if (skip > 0) {
+                skip -= ret;
+                if (ret == 0) {
+                    break;
+                }
+                continue;
+            }
 
-                auto current_version = esp_app_get_description()->version;
-                if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
-                    ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
-                    delete http;
-                    return;
+            recent_read += ret;
+            total_read += ret;
+            filled += ret;
+            progressed = progressed || ret > 0;
+
+            // Calculate speed and progress every second
+            auto now = esp_timer_get_time();
+            if (now - last_calc_time >= 1000000 || ret == 0) {
+                size_t progress = total_read * 100 / content_length;
+                size_t speed = recent_read * 1000000 / std::max<int64_t>(now - last_calc_time, 1);
+                ESP_LOGI(TAG, "Progress: %zu%% (%zu/%zu), Speed: %zuB/s", progress, total_read, content_length, speed);
+                if (upgrade_callback_) {
+                    upgrade_callback_(progress, speed);
                 }
+                last_calc_time = now;
+                recent_read = 0;
+            }
 
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
+            if (filled == OTA_WRITER_BUFFER_SIZE || (ret == 0 && filled > 0 && total_read >= content_length)) {
+                bool ok = submit(buffer, filled);
+                buffer = nullptr;
+                filled = 0;
+                if (!ok) {
                     delete http;
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return;
+                    return false;
                 }
+            }
+            if (ret == 0) {
+                completed = total_read >= content_length;
+                break;
+            }
+        }
+        delete http;
+
+        failures = progressed ? 1 : failures + 1;
+        if (!completed) {
+            ESP_LOGW(TAG, "Download interrupted at %zu/%zu", total_read, content_length);
+        }
+    }
+
+    auto elapsed = esp_timer_get_time() - start_time;
+    ESP_LOGI(TAG, "Downloaded %zu bytes in %lld ms, average %lldB/s", total_read, elapsed / 1000,
+        (int64_t)total_read * 1000000 / std::max<int64_t>(elapsed, 1));
+    return true;
+}
+
+void Ota::Upgrade(const std::string& firmware_url) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
+        return;
+    }
+    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
 
-                image_header_checked = true;
-                std::string().swap(image_header);
+    // The writer task flashes one buffer while the next one is downloaded.
+    // The first buffer is checked for the image header before the writer starts.
+    OtaWriter writer;
+    bool writer_started = false;
+    std::vector<uint8_t> first_buffer(OTA_WRITER_BUFFER_SIZE);
+    auto get_buffer = [&]() -> uint8_t* {
+        return writer_started ? writer.GetBuffer() : first_buffer.data();
+    };
+    auto submit = [&](uint8_t* buffer, size_t size) -> bool {
+        if (!writer_started) {
+            if (!CheckImageHeader(buffer, size) || !writer.Begin(update_partition)) {
+                return false;
             }
+            writer_started = true;
+            uint8_t* first = writer.GetBuffer();
+            memcpy(first, buffer, size);
+            std::vector<uint8_t>().swap(first_buffer);
+            buffer = first;
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            delete http;
+        return writer.Submit(buffer, size);
+    };
+    if (!Download(firmware_url, get_buffer, submit) || !writer_started) {
+        return;
+    }
+
+    uint8_t sha256[32];
+    if (!writer.Finish(sha256)) {
+        return;
+    }
+
+    if (!firmware_sha256_.empty()) {
+        std::string digest;
+        for (auto byte : sha256) {
+            char hex[3];
+            snprintf(hex, sizeof(hex), "%02x", byte);
+            digest += hex;
+        }
+        if (strcasecmp(digest.c_str(), firmware_sha256_.c_str()) != 0) {
+            ESP_LOGE(TAG, "SHA-256 mismatch: %s != %s", digest.c_str(), firmware_sha256_.c_str());
             return;
         }
     }
-    delete http;
 
-    esp_err_t err = esp_ota_end(update_handle);
+    esp_err_t err = writer.End();
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed, image is corrupted");
@@ -329,8 +528,40 @@ void Ota::Upgrade(const std::string& firmware_url) {
     esp_restart();
 }
 
+bool Ota::UpgradeWithPatch(const std::string& patch_url) {
+    ESP_LOGI(TAG, "Upgrading firmware with patch from %s", patch_url.c_str());
+
+    // The patch is applied while it downloads, the rebuilt image goes through an OtaWriter
+    OtaPatch patch;
+    std::vector<uint8_t> buffer(OTA_WRITER_BUFFER_SIZE);
+    auto get_buffer = [&]() -> uint8_t* {
+        return buffer.data();
+    };
+    auto submit = [&](uint8_t* data, size_t size) -> bool {
+        return patch.Write(data, size);
+    };
+    if (!Download(patch_url, get_buffer, submit) || !patch.Finish()) {
+        return false;
+    }
+
+    esp_err_t err = esp_ota_set_boot_partition(patch.update_partition());
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Firmware upgrade successful, rebooting in 3 seconds...");
+    vTaskDelay(pdMS_TO_TICKS(3000));
+    esp_restart();
+    return true;
+}
+
 void Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
+    // Fall back to the full image if the patch does not apply
+    if (!patch_url_.empty() && !UpgradeWithPatch(patch_url_)) {
+        ESP_LOGW(TAG, "Patch upgrade failed, downloading the full image");
+    }
     Upgrade(firmware_url_);
 }
 
@@ -16,10 +16,14 @@ public:
     void SetCheckVersionUrl(std::string check_version_url);
     void SetHeader(const std::string& key, const std::string& value);
     bool CheckVersion();
+    // Restore the config of the last successful check, returns false if there is none
+    bool LoadCachedConfig();
     esp_err_t Activate();
     bool HasActivationChallenge() { return has_activation_challenge_; }
     bool HasNewVersion() { return has_new_version_; }
     bool HasMqttConfig() { return has_mqtt_config_; }
+    // True once after a check saved a changed MQTT config, until the next change
+    bool TakeMqttConfigChanged();
     bool HasActivationCode() { return has_activation_code_; }
     bool HasServerTime() { return has_server_time_; }
     void StartUpgrade(std::function<void(int progress, size_t speed)> callback);
@@ -36,6 +40,7 @@ private:
     std::string activation_code_;
     bool has_new_version_ = false;
     bool has_mqtt_config_ = false;
+    bool mqtt_config_changed_ = false;
     bool has_server_time_ = false;
     bool has_activation_code_ = false;
     bool has_serial_number_ = false;
@@ -43,12 +48,20 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_sha256_;
+    std::string patch_url_;
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
     std::map<std::string, std::string> headers_;
 
+    // Download the url with resume, passing the data to submit in OTA_WRITER_BUFFER_SIZE chunks
+    bool Download(const std::string& url, const std::function<uint8_t*()>& get_buffer,
+        const std::function<bool(uint8_t* buffer, size_t size)>& submit);
     void Upgrade(const std::string& firmware_url);
+    bool UpgradeWithPatch(const std::string& patch_url);
+    bool CheckImageHeader(const uint8_t* data, size_t size);
+    bool ParseResponse(const std::string& data, bool cached);
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
@@ -0,0 +1,298 @@
+#include "ota_patch.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+#include <miniz.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "OtaPatch"
+
+#define OTA_PATCH_SOURCE_BUFFER_SIZE 4096
+
+OtaPatch::OtaPatch() {
+}
+
+OtaPatch::~OtaPatch() {
+    if (inflator_ != nullptr) {
+        heap_caps_free(inflator_);
+    }
+    if (dict_ != nullptr) {
+        heap_caps_free(dict_);
+    }
+}
+
+bool OtaPatch::Write(const uint8_t* data, size_t size) {
+    if (state_ == kStateError) {
+        return false;
+    }
+
+    if (state_ == kStateHeader) {
+        size_t n = std::min(size, sizeof(header_) - header_received_);
+        memcpy((uint8_t*)&header_ + header_received_, data, n);
+        header_received_ += n;
+        data += n;
+        size -= n;
+        if (header_received_ < sizeof(header_)) {
+            return true;
+        }
+        if (!Begin()) {
+            state_ = kStateError;
+            return false;
+        }
+        state_ = kStateControl;
+    }
+
+    if (size > 0 && !Inflate(data, size)) {
+        state_ = kStateError;
+        return false;
+    }
+    return true;
+}
+
+bool OtaPatch::Begin() {
+    if (header_.magic != OTA_PATCH_MAGIC || header_.version != OTA_PATCH_VERSION) {
+        ESP_LOGE(TAG, "Invalid patch header");
+        return false;
+    }
+
+    source_partition_ = esp_ota_get_running_partition();
+    update_partition_ = esp_ota_get_next_update_partition(NULL);
+    if (source_partition_ == nullptr || update_partition_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to get partitions");
+        return false;
+    }
+    if (header_.target_size == 0 || header_.source_size > source_partition_->size || header_.target_size > update_partition_->size) {
+        ESP_LOGE(TAG, "Patch does not fit the partitions");
+        return false;
+    }
+    if (!VerifySource()) {
+        return false;
+    }
+
+    inflator_ = (tinfl_decompressor*)heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_8BIT);
+    dict_ = (uint8_t*)heap_caps_malloc(TINFL_LZ_DICT_SIZE, MALLOC_CAP_8BIT);
+    if (inflator_ == nullptr || dict_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate inflator");
+        return false;
+    }
+    tinfl_init(inflator_);
+
+    if (!writer_.Begin(update_partition_)) {
+        return false;
+    }
+
+    source_buffer_.resize(OTA_PATCH_SOURCE_BUFFER_SIZE);
+    ESP_LOGI(TAG, "Patching %s (%lu bytes) into %s (%lu bytes)", source_partition_->label, header_.source_size,
+        update_partition_->label, header_.target_size);
+    return true;
+}
+
+bool OtaPatch::VerifySource() {
+    // The patch only applies to the exact image it was generated against
+    std::vector<uint8_t> buffer(OTA_PATCH_SOURCE_BUFFER_SIZE);
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    for (size_t offset = 0; offset < header_.source_size; offset += buffer.size()) {
+        size_t n = std::min(buffer.size(), header_.source_size - offset);
+        if (esp_partition_read(source_partition_, offset, buffer.data(), n) != ESP_OK) {
+            mbedtls_sha256_free(&sha256);
+            ESP_LOGE(TAG, "Failed to read running partition");
+            return false;
+        }
+        mbedtls_sha256_update(&sha256, buffer.data(), n);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha256, digest);
+    mbedtls_sha256_free(&sha256);
+    if (memcmp(digest, header_.source_sha256, sizeof(digest)) != 0) {
+        ESP_LOGW(TAG, "Patch was not generated for the running firmware");
+        return false;
+    }
+    return true;
+}
+
+bool OtaPatch::Inflate(const uint8_t* data, size_t size) {
+    while (!inflate_done_) {
+        size_t in_bytes = size;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_offset_;
+        auto status = tinfl_decompress(inflator_, data, &in_bytes, dict_, dict_ + dict_offset_, &out_bytes,
+            TINFL_FLAG_HAS_MORE_INPUT | TINFL_FLAG_PARSE_ZLIB_HEADER);
+        data += in_bytes;
+        size -= in_bytes;
+
+        if (out_bytes > 0 && !Process(dict_ + dict_offset_, out_bytes)) {
+            return false;
+        }
+        dict_offset_ = (dict_offset_ + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Failed to inflate patch: %d", status);
+            return false;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            inflate_done_ = true;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && size == 0) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool OtaPatch::Process(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        switch (state_) {
+        case kStateControl: {
+            size_t n = std::min(size, sizeof(control_) - control_received_);
+            memcpy(control_ + control_received_, data, n);
+            control_received_ += n;
+            data += n;
+            size -= n;
+            if (control_received_ == sizeof(control_)) {
+                control_received_ = 0;
+                memcpy(&remaining_, control_, 4);
+                memcpy(&extra_len_, control_ + 4, 4);
+                memcpy(&seek_, control_ + 8, 4);
+                state_ = kStateDiff;
+            }
+            break;
+        }
+        case kStateDiff: {
+            // New bytes are the source bytes plus the diff, byte by byte
+            uint8_t source[256];
+            size_t n = std::min({size, (size_t)remaining_, sizeof(source)});
+            if (!ReadSource(source, n)) {
+                return false;
+            }
+            for (size_t i = 0; i < n; i++) {
+                source[i] += data[i];
+            }
+            if (!Output(source, n)) {
+                return false;
+            }
+            source_position_ += n;
+            remaining_ -= n;
+            data += n;
+            size -= n;
+            break;
+        }
+        case kStateExtra: {
+            size_t n = std::min(size, (size_t)remaining_);
+            if (!Output(data, n)) {
+                return false;
+            }
+            remaining_ -= n;
+            data += n;
+            size -= n;
+            break;
+        }
+        default:
+            ESP_LOGE(TAG, "Unexpected patch data");
+            return false;
+        }
+
+        // Move on when the current section is complete, empty sections are skipped
+        if (state_ == kStateDiff && remaining_ == 0) {
+            remaining_ = extra_len_;
+            state_ = kStateExtra;
+        }
+        if (state_ == kStateExtra && remaining_ == 0) {
+            source_position_ += seek_;
+            state_ = kStateControl;
+        }
+    }
+    return true;
+}
+
+bool OtaPatch::ReadSource(uint8_t* data, size_t size) {
+    if (source_position_ < 0 || source_position_ + size > header_.source_size) {
+        ESP_LOGE(TAG, "Source position out of range: %lld", source_position_);
+        return false;
+    }
+    int64_t position = source_position_;
+    while (size > 0) {
+        if (source_buffer_offset_ < 0 || position < source_buffer_offset_ ||
+            position >= source_buffer_offset_ + (int64_t)source_buffer_.size()) {
+            source_buffer_offset_ = position & ~(int64_t)(OTA_PATCH_SOURCE_BUFFER_SIZE - 1);
+            size_t n = std::min((size_t)OTA_PATCH_SOURCE_BUFFER_SIZE, (size_t)(header_.source_size - source_buffer_offset_));
+            if (esp_partition_read(source_partition_, source_buffer_offset_, source_buffer_.data(), n) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to read running partition");
+                source_buffer_offset_ = -1;
+                return false;
+            }
+        }
+        size_t offset = position - source_buffer_offset_;
+        size_t n = std::min(size, source_buffer_.size() - offset);
+        memcpy(data, source_buffer_.data() + offset, n);
+        data += n;
+        size -= n;
+        position += n;
+    }
+    return true;
+}
+
+bool OtaPatch::Output(const uint8_t* data, size_t size) {
+    if (target_written_ + size > header_.target_size) {
+        ESP_LOGE(TAG, "Patch output exceeds the target size");
+        return false;
+    }
+    target_written_ += size;
+    while (size > 0) {
+        if (output_ == nullptr) {
+            output_ = writer_.GetBuffer();
+            output_size_ = 0;
+        }
+        size_t n = std::min(size, OTA_WRITER_BUFFER_SIZE - output_size_);
+        memcpy(output_ + output_size_, data, n);
+        output_size_ += n;
+        data += n;
+        size -= n;
+        if (output_size_ == OTA_WRITER_BUFFER_SIZE && !FlushOutput()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OtaPatch::FlushOutput() {
+    if (output_ == nullptr) {
+        return true;
+    }
+    bool ok = writer_.Submit(output_, output_size_);
+    output_ = nullptr;
+    output_size_ = 0;
+    return ok;
+}
+
+bool OtaPatch::Finish() {
+    if (state_ != kStateControl || control_received_ != 0 || !inflate_done_) {
+        ESP_LOGE(TAG, "Patch is incomplete");
+        return false;
+    }
+    if (!FlushOutput()) {
+        return false;
+    }
+    if (target_written_ != header_.target_size) {
+        ESP_LOGE(TAG, "Image size mismatch: %u != %lu", target_written_, header_.target_size);
+        return false;
+    }
+
+    uint8_t digest[32];
+    if (!writer_.Finish(digest)) {
+        return false;
+    }
+    if (memcmp(digest, header_.target_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "SHA-256 of the patched image does not match");
+        return false;
+    }
+
+    esp_err_t err = writer_.End();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+        return false;
+    }
+    state_ = kStateDone;
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef OTA_PATCH_H
+#define OTA_PATCH_H
+
+#include "ota_writer.h"
+
+#include <esp_partition.h>
+#include <esp_ota_ops.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Applies a delta patch generated by scripts/release.py patch.
+// The new image is rebuilt from the running partition while the patch is streamed,
+// and written into the update partition by an OtaWriter.
+//
+// Patch layout (little endian):
+//   header   OtaPatchHeader, not compressed
+//   commands zlib stream of { uint32 diff_len, uint32 extra_len, int32 seek,
+//            diff[diff_len], extra[extra_len] }
+//   Each command outputs diff_len bytes of (source + diff), then extra_len bytes
+//   of extra, then moves the source position by seek.
+#define OTA_PATCH_MAGIC 0x50445A58  // "XZDP"
+#define OTA_PATCH_VERSION 1
+
+struct tinfl_decompressor_tag;
+
+struct OtaPatchHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t source_size;
+    uint32_t target_size;
+    uint8_t source_sha256[32];
+    uint8_t target_sha256[32];
+};
+
+class OtaPatch {
+public:
+    OtaPatch();
+    ~OtaPatch();
+
+    // Feed the next chunk of the patch, returns false on error
+    bool Write(const uint8_t* data, size_t size);
+    // Check that the whole image was rebuilt and matches the target hash
+    bool Finish();
+
+    inline const esp_partition_t* update_partition() const { return update_partition_; }
+
+private:
+    enum State {
+        kStateHeader,
+        kStateControl,
+        kStateDiff,
+        kStateExtra,
+        kStateDone,
+        kStateError,
+    };
+
+    State state_ = kStateHeader;
+    OtaPatchHeader header_ = {};
+    size_t header_received_ = 0;
+
+    const esp_partition_t* source_partition_ = nullptr;
+    const esp_partition_t* update_partition_ = nullptr;
+    OtaWriter writer_;
+
+    tinfl_decompressor_tag* inflator_ = nullptr;
+    bool inflate_done_ = false;
+    uint8_t* dict_ = nullptr;
+    size_t dict_offset_ = 0;
+
+    uint8_t control_[12];
+    size_t control_received_ = 0;
+    uint32_t remaining_ = 0;
+    uint32_t extra_len_ = 0;
+    int32_t seek_ = 0;
+
+    int64_t source_position_ = 0;
+    std::vector<uint8_t> source_buffer_;
+    int64_t source_buffer_offset_ = -1;
+    // Buffer from the writer being filled with the rebuilt image
+    uint8_t* output_ = nullptr;
+    size_t output_size_ = 0;
+    size_t target_written_ = 0;
+
+    bool Begin();
+    bool VerifySource();
+    bool Inflate(const uint8_t* data, size_t size);
+    bool Process(const uint8_t* data, size_t size);
+    bool ReadSource(uint8_t* data, size_t size);
+    bool Output(const uint8_t* data, size_t size);
+    bool FlushOutput();
+};
+
+#endif // OTA_PATCH_H
@@ -0,0 +1,132 @@
+#include "ota_writer.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#define TAG "OtaWriter"
+
+OtaWriter::OtaWriter() {
+    mbedtls_sha256_init(&sha256_);
+}
+
+OtaWriter::~OtaWriter() {
+    Stop();
+    if (update_handle_ != 0) {
+        esp_ota_abort(update_handle_);
+    }
+    for (auto buffer : buffers_) {
+        heap_caps_free(buffer);
+    }
+    if (free_queue_ != nullptr) {
+        vQueueDelete(free_queue_);
+    }
+    if (write_queue_ != nullptr) {
+        vQueueDelete(write_queue_);
+    }
+    if (done_semaphore_ != nullptr) {
+        vSemaphoreDelete(done_semaphore_);
+    }
+    mbedtls_sha256_free(&sha256_);
+}
+
+bool OtaWriter::Begin(const esp_partition_t* partition) {
+    partition_ = partition;
+    free_queue_ = xQueueCreate(OTA_WRITER_BUFFER_COUNT, sizeof(uint8_t*));
+    write_queue_ = xQueueCreate(OTA_WRITER_BUFFER_COUNT + 1, sizeof(Chunk));
+    done_semaphore_ = xSemaphoreCreateBinary();
+    if (free_queue_ == nullptr || write_queue_ == nullptr || done_semaphore_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create queues");
+        return false;
+    }
+    for (auto& buffer : buffers_) {
+        buffer = (uint8_t*)heap_caps_malloc(OTA_WRITER_BUFFER_SIZE, MALLOC_CAP_8BIT);
+        if (buffer == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate buffer");
+            return false;
+        }
+        xQueueSend(free_queue_, &buffer, 0);
+    }
+
+    esp_err_t err = esp_ota_begin(partition_, OTA_WITH_SEQUENTIAL_WRITES, &update_handle_);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to begin OTA: %s", esp_err_to_name(err));
+        update_handle_ = 0;
+        return false;
+    }
+    mbedtls_sha256_starts(&sha256_, 0);
+
+    xTaskCreate([](void* arg) {
+        auto self = static_cast<OtaWriter*>(arg);
+        self->WriterTask();
+    }, "ota_writer", 4096, this, 3, &task_);
+    if (task_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return false;
+    }
+    return true;
+}
+
+void OtaWriter::WriterTask() {
+    while (true) {
+        Chunk chunk;
+        xQueueReceive(write_queue_, &chunk, portMAX_DELAY);
+        if (chunk.data == nullptr) {
+            break;
+        }
+        // Keep draining after a failure so that the downloader never blocks
+        if (!failed_) {
+            esp_err_t err = esp_ota_write(update_handle_, chunk.data, chunk.size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                failed_ = true;
+            } else {
+                mbedtls_sha256_update(&sha256_, chunk.data, chunk.size);
+                written_ += chunk.size;
+            }
+        }
+        xQueueSend(free_queue_, &chunk.data, portMAX_DELAY);
+    }
+    xSemaphoreGive(done_semaphore_);
+    vTaskDelete(NULL);
+}
+
+uint8_t* OtaWriter::GetBuffer() {
+    uint8_t* buffer = nullptr;
+    xQueueReceive(free_queue_, &buffer, portMAX_DELAY);
+    return buffer;
+}
+
+bool OtaWriter::Submit(uint8_t* buffer, size_t size) {
+    if (failed_) {
+        xQueueSend(free_queue_, &buffer, 0);
+        return false;
+    }
+    Chunk chunk = { buffer, size };
+    xQueueSend(write_queue_, &chunk, portMAX_DELAY);
+    return true;
+}
+
+void OtaWriter::Stop() {
+    if (task_ == nullptr) {
+        return;
+    }
+    Chunk chunk = { nullptr, 0 };
+    xQueueSend(write_queue_, &chunk, portMAX_DELAY);
+    xSemaphoreTake(done_semaphore_, portMAX_DELAY);
+    task_ = nullptr;
+}
+
+bool OtaWriter::Finish(uint8_t sha256[32]) {
+    Stop();
+    if (failed_) {
+        return false;
+    }
+    mbedtls_sha256_finish(&sha256_, sha256);
+    return true;
+}
+
+esp_err_t OtaWriter::End() {
+    esp_err_t err = esp_ota_end(update_handle_);
+    update_handle_ = 0;
+    return err;
+}
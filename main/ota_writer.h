@@ -0,0 +1,57 @@
+#ifndef OTA_WRITER_H
+#define OTA_WRITER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+
+#include <atomic>
+#include <cstdint>
+
+#define OTA_WRITER_BUFFER_SIZE (8 * 1024)
+#define OTA_WRITER_BUFFER_COUNT 2
+
+// Writes the OTA image from a separate task, so that the next buffer can be
+// downloaded while the previous one is erased and written to flash.
+// The SHA-256 of the image is computed along the way.
+class OtaWriter {
+public:
+    OtaWriter();
+    ~OtaWriter();
+
+    bool Begin(const esp_partition_t* partition);
+    // Get a free buffer of OTA_WRITER_BUFFER_SIZE bytes, blocks while all buffers are being written
+    uint8_t* GetBuffer();
+    // Queue the buffer from GetBuffer() to be written, returns false if a previous write failed
+    bool Submit(uint8_t* buffer, size_t size);
+    // Wait for all buffers to be written and get the SHA-256 of the image
+    bool Finish(uint8_t sha256[32]);
+    // Validate the image and close the OTA handle, must be called after Finish()
+    esp_err_t End();
+
+    inline size_t written() const { return written_; }
+
+private:
+    struct Chunk {
+        uint8_t* data;
+        size_t size;
+    };
+
+    const esp_partition_t* partition_ = nullptr;
+    esp_ota_handle_t update_handle_ = 0;
+    uint8_t* buffers_[OTA_WRITER_BUFFER_COUNT] = {};
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t write_queue_ = nullptr;
+    SemaphoreHandle_t done_semaphore_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    mbedtls_sha256_context sha256_;
+    std::atomic<bool> failed_ = false;
+    std::atomic<size_t> written_ = 0;
+
+    void WriterTask();
+    void Stop();
+};
+
+#endif // OTA_WRITER_H
@@ -65,49 +65,17 @@ void Protocol::SendStopListening() {
     SendText(message);
 }
 
-void Protocol::SendIotDescriptors(const std::string& descriptors) {
-    cJSON* root = cJSON_Parse(descriptors.c_str());
-    if (root == nullptr) {
-        ESP_LOGE(TAG, "Failed to parse IoT descriptors: %s", descriptors.c_str());
-        return;
+void Protocol::SendIotDescriptors(const std::vector<std::string>& descriptors) {
+    // One message per thing, the cached descriptors are spliced in as they are
+    std::string prefix = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"iot\",\"update\":true,\"descriptors\":[";
+    std::string message;
+    for (auto& descriptor : descriptors) {
+        message.reserve(prefix.size() + descriptor.size() + 2);
+        message = prefix;
+        message += descriptor;
+        message += "]}";
+        SendText(message);
     }
-
-    if (!cJSON_IsArray(root)) {
-        ESP_LOGE(TAG, "IoT descriptors should be an array");
-        cJSON_Delete(root);
-        return;
-    }
-
-    int arraySize = cJSON_GetArraySize(root);
-    for (int i = 0; i < arraySize; ++i) {
-        cJSON* descriptor = cJSON_GetArrayItem(root, i);
-        if (descriptor == nullptr) {
-            ESP_LOGE(TAG, "Failed to get IoT descriptor at index %d", i);
-            continue;
-        }
-
-        cJSON* messageRoot = cJSON_CreateObject();
-        cJSON_AddStringToObject(messageRoot, "session_id", session_id_.c_str());
-        cJSON_AddStringToObject(messageRoot, "type", "iot");
-        cJSON_AddBoolToObject(messageRoot, "update", true);
-
-        cJSON* descriptorArray = cJSON_CreateArray();
-        cJSON_AddItemToArray(descriptorArray, cJSON_Duplicate(descriptor, 1));
-        cJSON_AddItemToObject(messageRoot, "descriptors", descriptorArray);
-
-        char* message = cJSON_PrintUnformatted(messageRoot);
-        if (message == nullptr) {
-            ESP_LOGE(TAG, "Failed to print JSON message for IoT descriptor at index %d", i);
-            cJSON_Delete(messageRoot);
-            continue;
-        }
-
-        SendText(std::string(message));
-        cJSON_free(message);
-        cJSON_Delete(messageRoot);
-    }
-
-    cJSON_Delete(root);
 }
 
 void Protocol::SendIotStates(const std::string& states) {
@@ -115,6 +83,11 @@ void Protocol::SendIotStates(const std::string& states) {
     SendText(message);
 }
 
+void Protocol::SendIotResult(const std::string& result) {
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"iot\",\"result\":" + result + "}";
+    SendText(message);
+}
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
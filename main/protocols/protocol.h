@@ -5,6 +5,7 @@
 #include <string>
 #include <functional>
 #include <chrono>
+#include <vector>
 
 struct BinaryProtocol3 {
     uint8_t type;
@@ -54,8 +55,9 @@ public:
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
-    virtual void SendIotDescriptors(const std::string& descriptors);
+    virtual void SendIotDescriptors(const std::vector<std::string>& descriptors);
     virtual void SendIotStates(const std::string& states);
+    virtual void SendIotResult(const std::string& result);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
@@ -1,58 +1,272 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <map>
+#include <mutex>
 
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
+// Changes made within this delay are committed together
+#define SETTINGS_COMMIT_DELAY_MS 3000
+
+namespace {
+
+class SettingsCache {
+public:
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
+    }
+
+    bool GetString(const std::string& ns, const std::string& key, std::string& value);
+    bool GetInt(const std::string& ns, const std::string& key, int32_t& value);
+    void SetString(const std::string& ns, const std::string& key, const std::string& value);
+    void SetInt(const std::string& ns, const std::string& key, int32_t value);
+    void EraseKey(const std::string& ns, const std::string& key);
+    void EraseAll(const std::string& ns);
+    void Flush();
+
+private:
+    enum EntryType {
+        kEntryNone,
+        kEntryInt,
+        kEntryString,
+    };
+
+    struct Entry {
+        EntryType type = kEntryNone;
+        int32_t int_value = 0;
+        std::string string_value;
+        // Types already looked up in NVS and not found
+        bool int_missing = false;
+        bool string_missing = false;
+        bool dirty = false;
+    };
+
+    struct Namespace {
+        std::map<std::string, Entry> entries;
+        bool erase_all = false;
+        bool dirty = false;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, Namespace> namespaces_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+
+    SettingsCache();
+    void MarkDirty(Namespace& ns, Entry& entry);
+};
+
+SettingsCache::SettingsCache() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            // Writing flash can take tens of milliseconds, keep it off the esp_timer task
+            if (xTaskCreate([](void* arg) {
+                static_cast<SettingsCache*>(arg)->Flush();
+                vTaskDelete(NULL);
+            }, "settings_commit", 4096, arg, 1, nullptr) != pdPASS) {
+                static_cast<SettingsCache*>(arg)->Flush();
+            }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "settings_commit",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &commit_timer_));
+    // Pending changes must survive esp_restart()
+    esp_register_shutdown_handler([]() {
+        SettingsCache::GetInstance().Flush();
+    });
 }
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+bool SettingsCache::GetString(const std::string& ns, const std::string& key, std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& n = namespaces_[ns];
+    auto& entry = n.entries[key];
+    if (entry.type == kEntryNone && !entry.string_missing && !entry.dirty && !n.erase_all) {
+        entry.string_missing = true;
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) == ESP_OK) {
+            size_t length = 0;
+            if (nvs_get_str(handle, key.c_str(), nullptr, &length) == ESP_OK) {
+                entry.string_value.resize(length);
+                if (nvs_get_str(handle, key.c_str(), entry.string_value.data(), &length) == ESP_OK) {
+                    while (!entry.string_value.empty() && entry.string_value.back() == '\0') {
+                        entry.string_value.pop_back();
+                    }
+                    entry.type = kEntryString;
+                    entry.string_missing = false;
+                }
+            }
+            nvs_close(handle);
+        }
+    }
+    if (entry.type != kEntryString) {
+        return false;
+    }
+    value = entry.string_value;
+    return true;
+}
+
+bool SettingsCache::GetInt(const std::string& ns, const std::string& key, int32_t& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& n = namespaces_[ns];
+    auto& entry = n.entries[key];
+    if (entry.type == kEntryNone && !entry.int_missing && !entry.dirty && !n.erase_all) {
+        entry.int_missing = true;
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) == ESP_OK) {
+            if (nvs_get_i32(handle, key.c_str(), &entry.int_value) == ESP_OK) {
+                entry.type = kEntryInt;
+                entry.int_missing = false;
+            }
+            nvs_close(handle);
         }
-        nvs_close(nvs_handle_);
     }
+    if (entry.type != kEntryInt) {
+        return false;
+    }
+    value = entry.int_value;
+    return true;
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+void SettingsCache::MarkDirty(Namespace& ns, Entry& entry) {
+    entry.dirty = true;
+    ns.dirty = true;
+    // The first change starts the delay, later ones are written with it
+    if (!esp_timer_is_active(commit_timer_)) {
+        esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_MS * 1000);
     }
+}
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+void SettingsCache::SetString(const std::string& ns, const std::string& key, const std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& n = namespaces_[ns];
+    auto& entry = n.entries[key];
+    if (entry.type == kEntryString && entry.string_value == value) {
+        return;
     }
+    entry.type = kEntryString;
+    entry.string_value = value;
+    MarkDirty(n, entry);
+}
 
+void SettingsCache::SetInt(const std::string& ns, const std::string& key, int32_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& n = namespaces_[ns];
+    auto& entry = n.entries[key];
+    if (entry.type == kEntryInt && entry.int_value == value) {
+        return;
+    }
+    entry.type = kEntryInt;
+    entry.int_value = value;
+    MarkDirty(n, entry);
+}
+
+void SettingsCache::EraseKey(const std::string& ns, const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& n = namespaces_[ns];
+    auto& entry = n.entries[key];
+    entry.type = kEntryNone;
+    entry.string_value.clear();
+    entry.int_missing = true;
+    entry.string_missing = true;
+    MarkDirty(n, entry);
+}
+
+void SettingsCache::EraseAll(const std::string& ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& n = namespaces_[ns];
+    n.entries.clear();
+    n.erase_all = true;
+    n.dirty = true;
+    if (!esp_timer_is_active(commit_timer_)) {
+        esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_MS * 1000);
+    }
+}
+
+void SettingsCache::Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    esp_timer_stop(commit_timer_);
+    for (auto& [name, n] : namespaces_) {
+        if (!n.dirty) {
+            continue;
+        }
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(name.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", name.c_str(), esp_err_to_name(err));
+            continue;
+        }
+        if (n.erase_all) {
+            nvs_erase_all(handle);
+            n.erase_all = false;
+        }
+        int count = 0;
+        for (auto& [key, entry] : n.entries) {
+            if (!entry.dirty) {
+                continue;
+            }
+            if (entry.type == kEntryInt) {
+                err = nvs_set_i32(handle, key.c_str(), entry.int_value);
+            } else if (entry.type == kEntryString) {
+                err = nvs_set_str(handle, key.c_str(), entry.string_value.c_str());
+            } else {
+                err = nvs_erase_key(handle, key.c_str());
+                if (err == ESP_ERR_NVS_NOT_FOUND) {
+                    err = ESP_OK;
+                }
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", name.c_str(), key.c_str(), esp_err_to_name(err));
+            }
+            entry.dirty = false;
+            count++;
+        }
+        err = nvs_commit(handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit namespace %s: %s", name.c_str(), esp_err_to_name(err));
+        }
+        nvs_close(handle);
+        n.dirty = false;
+        ESP_LOGI(TAG, "Committed %d keys to %s", count, name.c_str());
+    }
+}
+
+} // namespace
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
     std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    if (!SettingsCache::GetInstance().GetString(ns_, key, value)) {
+        return default_value;
     }
     return value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetString(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
     int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    if (!SettingsCache::GetInstance().GetInt(ns_, key, value)) {
         return default_value;
     }
     return value;
@@ -60,8 +274,7 @@ int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetInt(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -69,10 +282,7 @@ void Settings::SetInt(const std::string& key, int32_t value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsCache::GetInstance().EraseKey(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -80,8 +290,12 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsCache::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
+
+void Settings::Flush() {
+    SettingsCache::GetInstance().Flush();
+}
@@ -4,6 +4,9 @@
 #include <string>
 #include <nvs_flash.h>
 
+// Settings are read through a process wide cache, loaded per key on first use.
+// Changes are written back to NVS by a deferred commit that coalesces
+// all changes made within SETTINGS_COMMIT_DELAY_MS, and on restart.
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
@@ -16,11 +19,12 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Write all pending changes to NVS now, e.g. before sleep or power off
+    static void Flush();
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
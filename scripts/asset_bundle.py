@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+# Pack assets into the bundle read by main/asset_bundle.cc
+#
+# The bundle is flashed to the "assets" partition by `idf.py flash` when
+# CONFIG_USE_ASSET_PARTITION is enabled, or manually:
+#   python scripts/asset_bundle.py pack build/assets.bin main/assets/zh-CN/*.p3 main/assets/common/*.p3
+#   parttool.py write_partition --partition-name=assets --input=build/assets.bin
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = 0x42545341  # "ASTB"
+VERSION = 2
+NAME_SIZE = 32
+ALIGN = 4
+HEADER_FORMAT = "<IHHII"
+ENTRY_FORMAT = f"<{NAME_SIZE}sII"
+
+
+def align(value):
+    return (value + ALIGN - 1) // ALIGN * ALIGN
+
+
+def signature(names):
+    """FNV-1a of the sorted asset names, also written to lang_config.h by gen_lang.py.
+    The firmware only uses a bundle with the asset names it was built with."""
+    value = 0x811C9DC5
+    for name in sorted(names, key=lambda n: n.encode()):
+        for byte in name.encode() + b"\0":
+            value = ((value ^ byte) * 0x01000193) & 0xFFFFFFFF
+    return value
+
+
+def build(files):
+    assets = {}
+    for path in files:
+        name = os.path.basename(path)
+        if len(name.encode()) >= NAME_SIZE:
+            sys.exit(f"Asset name too long: {name}")
+        if name in assets:
+            sys.exit(f"Duplicate asset: {name}")
+        with open(path, "rb") as f:
+            assets[name] = f.read()
+
+    # Sorted by bytes so that the device can binary search with strncmp
+    names = sorted(assets, key=lambda n: n.encode())
+    data_offset = align(struct.calcsize(HEADER_FORMAT) + len(names) * struct.calcsize(ENTRY_FORMAT))
+    entries = bytearray()
+    data = bytearray()
+    for name in names:
+        offset = data_offset + len(data)
+        entries += struct.pack(ENTRY_FORMAT, name.encode(), offset, len(assets[name]))
+        data += assets[name]
+        data += b"\0" * (align(len(data)) - len(data))
+
+    total_size = data_offset + len(data)
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(names), total_size, signature(names))
+    table = header + entries
+    return table + b"\0" * (data_offset - len(table)) + data
+
+
+def parse(bundle):
+    magic, version, count, total_size, bundle_signature = struct.unpack_from(HEADER_FORMAT, bundle, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("Not an asset bundle")
+    if total_size > len(bundle):
+        raise ValueError("Truncated bundle")
+    assets = {}
+    previous = b""
+    for i in range(count):
+        offset = struct.calcsize(HEADER_FORMAT) + i * struct.calcsize(ENTRY_FORMAT)
+        name, data_offset, size = struct.unpack_from(ENTRY_FORMAT, bundle, offset)
+        name = name.rstrip(b"\0")
+        if name <= previous:
+            raise ValueError(f"Entries not sorted at {name}")
+        if data_offset % ALIGN != 0 or data_offset + size > total_size:
+            raise ValueError(f"Invalid entry {name}")
+        assets[name.decode()] = bundle[data_offset:data_offset + size]
+        previous = name
+    if signature(assets) != bundle_signature:
+        raise ValueError("Signature does not match the asset names")
+    return assets
+
+
+def pack(output_file, files):
+    bundle = build(files)
+    os.makedirs(os.path.dirname(os.path.abspath(output_file)), exist_ok=True)
+    with open(output_file, "wb") as f:
+        f.write(bundle)
+    print(f"Packed {len(files)} assets, {len(bundle)} bytes to {output_file}")
+
+
+def verify(bundle_file, files):
+    with open(bundle_file, "rb") as f:
+        assets = parse(f.read())
+    for path in files:
+        name = os.path.basename(path)
+        with open(path, "rb") as f:
+            if assets.get(name) != f.read():
+                sys.exit(f"Mismatch: {name}")
+    for name, data in sorted(assets.items()):
+        print(f"{name:<32} {len(data):>8} bytes")
+    print(f"Signature {signature(assets):08x}")
+
+
+def test(assets_dir):
+    # Round trip the asset set of every language together with the common assets
+    common = [os.path.join(assets_dir, "common", f) for f in sorted(os.listdir(os.path.join(assets_dir, "common")))]
+    for lang in sorted(os.listdir(assets_dir)):
+        lang_dir = os.path.join(assets_dir, lang)
+        if lang == "common" or not os.path.isdir(lang_dir):
+            continue
+        files = [os.path.join(lang_dir, f) for f in sorted(os.listdir(lang_dir)) if f.endswith(".p3")]
+        files += [f for f in common if f.endswith(".p3")]
+        bundle = build(files)
+        assets = parse(bundle)
+        if len(assets) != len(files):
+            sys.exit(f"{lang}: expected {len(files)} assets, got {len(assets)}")
+        for path in files:
+            with open(path, "rb") as f:
+                if assets[os.path.basename(path)] != f.read():
+                    sys.exit(f"{lang}: mismatch {path}")
+        # A bundle packed for another asset set must not pass as this one
+        if signature(os.path.basename(f) for f in files[1:]) == signature(assets):
+            sys.exit(f"{lang}: signature does not change with the asset names")
+        print(f"{lang}: {len(files)} assets, {len(bundle)} bytes OK")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Pack assets into a bundle for the assets partition")
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    pack_parser = subparsers.add_parser("pack", help="Pack files into a bundle")
+    pack_parser.add_argument("output_file", help="Output bundle file")
+    pack_parser.add_argument("files", nargs="+", help="Asset files, looked up by file name")
+
+    verify_parser = subparsers.add_parser("verify", help="Check a bundle against the source files")
+    verify_parser.add_argument("bundle_file", help="Bundle file")
+    verify_parser.add_argument("files", nargs="*", help="Asset files to compare")
+
+    test_parser = subparsers.add_parser("test", help="Round trip the asset set of every language")
+    test_parser.add_argument("assets_dir", nargs="?", default=os.path.join(os.path.dirname(__file__), "..", "main", "assets"))
+
+    args = parser.parse_args()
+    if args.command == "pack":
+        pack(args.output_file, args.files)
+    elif args.command == "verify":
+        verify(args.bundle_file, args.files)
+    else:
+        test(args.assets_dir)
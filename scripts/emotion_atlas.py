@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+# Pack emotion animations into the atlas read by main/display/emotion_animation.cc
+#
+# The input directory contains one GIF per emotion (happy.gif) or one sub directory
+# per emotion with numbered PNG frames (happy/0.png, happy/1.png, ...).
+#
+# With CONFIG_USE_EMOTION_ATLAS the build packs CONFIG_EMOTION_ATLAS_DIR and idf.py flash
+# writes it to the "emotions" partition. To pack and flash by hand:
+#   python scripts/emotion_atlas.py pack emotions/ build/emotions.bin -s 64 --fps 10
+#   parttool.py write_partition --partition-name=emotions --input=build/emotions.bin
+#
+# tests/host/emotion_blit_benchmark times the firmware decoder and blit on an atlas.
+import argparse
+import os
+import struct
+import sys
+import time
+
+from PIL import Image, ImageSequence
+
+MAGIC = 0x414F4D45  # "EMOA"
+VERSION = 1
+NAME_SIZE = 16
+HEADER_FORMAT = "<IHHHHHH"
+EMOTION_FORMAT = f"<{NAME_SIZE}sHH"
+FRAME_FORMAT = "<II"
+
+
+def to_rgb565(image, size, background):
+    canvas = Image.new("RGBA", (size, size), background)
+    image = image.convert("RGBA")
+    image.thumbnail((size, size), Image.LANCZOS)
+    canvas.alpha_composite(image, ((size - image.width) // 2, (size - image.height) // 2))
+    pixels = []
+    for r, g, b, _ in canvas.getdata():
+        pixels.append(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3))
+    return pixels
+
+
+def encode_rle(pixels):
+    runs = bytearray()
+    i = 0
+    while i < len(pixels):
+        color = pixels[i]
+        count = 1
+        while i + count < len(pixels) and pixels[i + count] == color and count < 0xFFFF:
+            count += 1
+        runs += struct.pack("<HH", count, color)
+        i += count
+    return bytes(runs)
+
+
+def decode_rle(data, total):
+    pixels = []
+    for offset in range(0, len(data), 4):
+        count, color = struct.unpack_from("<HH", data, offset)
+        pixels.extend([color] * min(count, total - len(pixels)))
+    pixels.extend([0] * (total - len(pixels)))
+    return pixels
+
+
+def load_frames(path):
+    if os.path.isdir(path):
+        files = sorted(os.listdir(path), key=lambda f: (len(f), f))
+        return [Image.open(os.path.join(path, f)) for f in files if f.lower().endswith(".png")]
+    return [frame.copy() for frame in ImageSequence.Iterator(Image.open(path))]
+
+
+def pack(input_dir, output_file, size, fps, background):
+    emotions = []
+    for entry in sorted(os.listdir(input_dir)):
+        name, ext = os.path.splitext(entry)
+        path = os.path.join(input_dir, entry)
+        if not (os.path.isdir(path) or ext.lower() == ".gif"):
+            continue
+        if len(name.encode()) >= NAME_SIZE:
+            sys.exit(f"Emotion name too long: {name}")
+        frames = [encode_rle(to_rgb565(frame, size, background)) for frame in load_frames(path)]
+        if frames:
+            emotions.append((name, frames))
+
+    frame_count = sum(len(frames) for _, frames in emotions)
+    data_offset = (struct.calcsize(HEADER_FORMAT) + len(emotions) * struct.calcsize(EMOTION_FORMAT)
+                   + frame_count * struct.calcsize(FRAME_FORMAT))
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(emotions), frame_count, size, size, fps)
+    emotion_table = bytearray()
+    frame_table = bytearray()
+    data = bytearray()
+    first_frame = 0
+    for name, frames in emotions:
+        emotion_table += struct.pack(EMOTION_FORMAT, name.encode(), first_frame, len(frames))
+        first_frame += len(frames)
+        for frame in frames:
+            frame_table += struct.pack(FRAME_FORMAT, data_offset + len(data), len(frame))
+            data += frame
+        runs = [len(frame) // 4 for frame in frames]
+        print(f"{name:<16} {len(frames):>3} frames, {sum(len(f) for f in frames):>8} bytes, "
+              f"runs per frame avg {sum(runs) / len(runs):.0f} max {max(runs)}")
+
+    with open(output_file, "wb") as f:
+        f.write(header + emotion_table + frame_table + data)
+    print(f"Packed {len(emotions)} emotions, {frame_count} frames, {data_offset + len(data)} bytes to {output_file}")
+
+
+def verify(atlas_file):
+    with open(atlas_file, "rb") as f:
+        atlas = f.read()
+    magic, version, emotion_count, frame_count, width, height, fps = struct.unpack_from(HEADER_FORMAT, atlas, 0)
+    if magic != MAGIC or version != VERSION:
+        sys.exit("Not an emotion atlas")
+    offset = struct.calcsize(HEADER_FORMAT) + emotion_count * struct.calcsize(EMOTION_FORMAT)
+    total = width * height
+    budget_us = 1000000 / fps
+    start = time.perf_counter()
+    for i in range(frame_count):
+        frame_offset, frame_size = struct.unpack_from(FRAME_FORMAT, atlas, offset + i * struct.calcsize(FRAME_FORMAT))
+        if frame_offset + frame_size > len(atlas) or frame_size % 4 != 0:
+            sys.exit(f"Invalid frame {i}")
+        decode_rle(atlas[frame_offset:frame_offset + frame_size], total)
+    elapsed_us = (time.perf_counter() - start) * 1e6
+    # The device decodes about the same number of runs, this shows the relative cost between atlases
+    print(f"{frame_count} frames of {width}x{height} at {fps} fps, frame budget {budget_us:.0f} us, "
+          f"host decode avg {elapsed_us / max(frame_count, 1):.0f} us")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Pack emotion animations into an atlas")
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    pack_parser = subparsers.add_parser("pack", help="Pack GIFs or PNG frame directories")
+    pack_parser.add_argument("input_dir", help="Directory with <emotion>.gif or <emotion>/ frames")
+    pack_parser.add_argument("output_file", help="Output atlas file")
+    pack_parser.add_argument("-s", "--size", type=int, default=64, help="Frame width and height (default: 64)")
+    pack_parser.add_argument("--fps", type=int, default=10, help="Frames per second (default: 10)")
+    pack_parser.add_argument("--background", default="#FFFFFF", help="Background color (default: #FFFFFF)")
+
+    verify_parser = subparsers.add_parser("verify", help="Check an atlas and time the frame decoding")
+    verify_parser.add_argument("atlas_file", help="Atlas file")
+
+    args = parser.parse_args()
+    if args.command == "pack":
+        pack(args.input_dir, args.output_file, args.size, args.fps, args.background)
+    else:
+        verify(args.atlas_file)
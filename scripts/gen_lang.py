@@ -3,11 +3,14 @@ import argparse
 import json
 import os
 
+from asset_bundle import signature
+
 HEADER_TEMPLATE = """// Auto-generated language config
 #pragma once
 
 #include <string_view>
-
+#include <cstdint>
+{extra_includes}
 #ifndef {lang_code_for_font}
     #define {lang_code_for_font}  // 預設語言
 #endif
@@ -15,6 +18,8 @@ HEADER_TEMPLATE = """// Auto-generated language config
 namespace Lang {{
     // 语言元数据
     constexpr const char* CODE = "{lang_code}";
+    // assets 分区中的音效签名，与固件的音效不一致时不使用该分区
+    constexpr uint32_t ASSETS_SIGNATURE = 0x{assets_signature:08x};
 
     // 字符串资源
     namespace Strings {{
@@ -28,7 +33,24 @@ namespace Lang {{
 }}
 """
 
-def generate_header(input_path, output_path):
+def sound_entry(base_name, use_assets, fallback):
+    embedded = f'''
+        extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
+        extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");'''
+    if use_assets:
+        # 音效存放在 assets 分区，使用时按文件名查找，分区无效时使用嵌入固件的备用音效
+        if fallback:
+            return embedded + f'''
+        static const AssetRef P3_{base_name.upper()} {{"{base_name}.p3", p3_{base_name}_start, p3_{base_name}_end}};'''
+        return f'''
+        constexpr AssetRef P3_{base_name.upper()} {{"{base_name}.p3"}};'''
+    return embedded + f'''
+        static const std::string_view P3_{base_name.upper()} {{
+        static_cast<const char*>(p3_{base_name}_start),
+        static_cast<size_t>(p3_{base_name}_end - p3_{base_name}_start)
+        }};'''
+
+def generate_header(input_path, output_path, use_assets=False, fallback=False):
     with open(input_path, 'r', encoding='utf-8') as f:
         data = json.load(f)
 
@@ -41,6 +63,7 @@ def generate_header(input_path, output_path):
     # 生成字符串常量
     strings = []
     sounds = []
+    sound_files = []
     for key, value in data['strings'].items():
         value = value.replace('"', '\\"')
         strings.append(f'        constexpr const char* {key.upper()} = "{value}";')
@@ -49,29 +72,21 @@ def generate_header(input_path, output_path):
     for file in os.listdir(os.path.dirname(input_path)):
         if file.endswith('.p3'):
             base_name = os.path.splitext(file)[0]
-            sounds.append(f'''
-        extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
-        extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
-        static const std::string_view P3_{base_name.upper()} {{
-        static_cast<const char*>(p3_{base_name}_start),
-        static_cast<size_t>(p3_{base_name}_end - p3_{base_name}_start)
-        }};''')
+            sounds.append(sound_entry(base_name, use_assets, fallback))
+            sound_files.append(file)
     
     # 生成公共音效
     for file in os.listdir(os.path.join(os.path.dirname(output_path), 'common')):
         if file.endswith('.p3'):
             base_name = os.path.splitext(file)[0]
-            sounds.append(f'''
-        extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
-        extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
-        static const std::string_view P3_{base_name.upper()} {{
-        static_cast<const char*>(p3_{base_name}_start),
-        static_cast<size_t>(p3_{base_name}_end - p3_{base_name}_start)
-        }};''')
+            sounds.append(sound_entry(base_name, use_assets, fallback))
+            sound_files.append(file)
 
     # 填充模板
     content = HEADER_TEMPLATE.format(
+        extra_includes='#include "asset_bundle.h"\n' if use_assets else '',
         lang_code=lang_code,
+        assets_signature=signature(sound_files),
         lang_code_for_font=lang_code.replace('-', '_').lower(),
         strings="\n".join(sorted(strings)),
         sounds="\n".join(sorted(sounds))
@@ -86,6 +101,8 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("--input", required=True, help="输入JSON文件路径")
     parser.add_argument("--output", required=True, help="输出头文件路径")
+    parser.add_argument("--assets", action="store_true", help="音效从 assets 分区读取，不嵌入固件")
+    parser.add_argument("--fallback", action="store_true", help="同时嵌入音效，assets 分区无效时使用")
     args = parser.parse_args()
 
-    generate_header(args.input, args.output)
\ No newline at end of file
+    generate_header(args.input, args.output, args.assets, args.fallback)
\ No newline at end of file
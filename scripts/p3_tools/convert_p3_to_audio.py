@@ -6,6 +6,23 @@ from tqdm import tqdm
 import soundfile as sf
 
 
+def iter_p3_packets(f):
+    """
+    逐个读取p3文件中的Opus数据
+    p3格式: [1字节类型, 1字节保留, 2字节长度, Opus数据]
+    """
+    while True:
+        header = f.read(4)
+        if not header or len(header) < 4:
+            break
+
+        pkt_type, reserved, opus_len = struct.unpack(">BBH", header)
+        opus_data = f.read(opus_len)
+        if len(opus_data) != opus_len:
+            break
+        yield opus_data
+
+
 def decode_p3_to_audio(input_file, output_file):
     sample_rate = 16000
     channels = 1
@@ -20,20 +37,11 @@ def decode_p3_to_audio(input_file, output_file):
         f.seek(0)
 
         with tqdm(total=total_size, unit="B", unit_scale=True) as pbar:
-            while True:
-                header = f.read(4)
-                if not header or len(header) < 4:
-                    break
-
-                pkt_type, reserved, opus_len = struct.unpack(">BBH", header)
-                opus_data = f.read(opus_len)
-                if len(opus_data) != opus_len:
-                    break
-
+            for opus_data in iter_p3_packets(f):
                 pcm = decoder.decode(opus_data, frame_size)
                 pcm_frames.append(np.frombuffer(pcm, dtype=np.int16))
 
-                pbar.update(4 + opus_len)
+                pbar.update(4 + len(opus_data))
 
     if not pcm_frames:
         raise ValueError("No valid audio data found")
@@ -0,0 +1,185 @@
+# Replay recorded WAV and P3 files through a Python model of the audio stages
+#
+# Uplink:   WAV -> capture -> resample to 16000Hz -> opus encode -> P3 packet
+# Downlink: P3  -> opus decode -> resample to output rate -> output
+#
+# The stages run frame by frame in the same order as Application::OnAudioInput / OnAudioOutput,
+# so recorded field captures can be turned into P3 files and back deterministically.
+# The stages are implemented with numpy and opuslib, not the firmware code, so the
+# reported times only compare inputs and encoder settings with each other on the host,
+# they are not a measurement of the device audio chain.
+import argparse
+import struct
+import time
+import tracemalloc
+
+import numpy as np
+import opuslib
+import soundfile as sf
+
+from convert_p3_to_audio import iter_p3_packets
+
+
+FRAME_DURATION_MS = 60
+ENCODE_SAMPLE_RATE = 16000
+
+
+class StreamResampler:
+    """Streaming linear resampler, keeps the last sample between frames"""
+
+    def __init__(self, input_rate, output_rate):
+        self.step = input_rate / output_rate
+        # The first point of each frame is the last sample of the previous one
+        self.position = 1.0
+        self.last = np.zeros(1, dtype=np.float32)
+
+    def process(self, pcm):
+        if self.step == 1.0:
+            return pcm
+        data = np.concatenate([self.last, pcm.astype(np.float32)])
+        end = len(data) - 1
+        count = int((end - self.position) / self.step) + 1 if self.position <= end else 0
+        points = self.position + np.arange(count) * self.step
+        output = np.interp(points, np.arange(len(data)), data)
+        self.position += count * self.step - end
+        self.last = data[-1:]
+        return np.clip(np.round(output), -32768, 32767).astype(np.int16)
+
+
+class StageStats:
+    def __init__(self, name):
+        self.name = name
+        self.cpu = 0.0
+        self.max_cpu = 0.0
+        self.calls = 0
+        self.alloc_bytes = 0
+
+    def run(self, func, *args):
+        snapshot = tracemalloc.get_traced_memory()[0]
+        start = time.process_time()
+        result = func(*args)
+        elapsed = time.process_time() - start
+        self.alloc_bytes += max(0, tracemalloc.get_traced_memory()[0] - snapshot)
+        self.cpu += elapsed
+        self.max_cpu = max(self.max_cpu, elapsed)
+        self.calls += 1
+        return result
+
+    def report(self, audio_seconds):
+        if self.calls == 0:
+            return
+        avg_us = self.cpu / self.calls * 1e6
+        load = self.cpu / audio_seconds * 100 if audio_seconds > 0 else 0
+        print(f"  {self.name:<12} calls={self.calls:<6} avg={avg_us:8.1f}us max={self.max_cpu * 1e6:8.1f}us "
+              f"load={load:6.2f}% alloc={self.alloc_bytes / 1024:8.1f}KB")
+
+
+def load_wav(path):
+    audio, sample_rate = sf.read(path, dtype="int16", always_2d=True)
+    # Keep the first channel, it is the mic channel of a field capture
+    return audio[:, 0], sample_rate
+
+
+def read_p3(path):
+    with open(path, "rb") as f:
+        return list(iter_p3_packets(f))
+
+
+def run_uplink(input_file, output_file, complexity):
+    audio, sample_rate = load_wav(input_file)
+    frame_size = sample_rate * FRAME_DURATION_MS // 1000
+    encode_frame_size = ENCODE_SAMPLE_RATE * FRAME_DURATION_MS // 1000
+
+    encoder = opuslib.Encoder(ENCODE_SAMPLE_RATE, 1, opuslib.APPLICATION_VOIP)
+    encoder.complexity = complexity
+    resampler = StreamResampler(sample_rate, ENCODE_SAMPLE_RATE)
+    stages = [StageStats("capture"), StageStats("resample"), StageStats("encode"), StageStats("packetize")]
+    capture, resample, encode, packetize = stages
+
+    pending = np.zeros(0, dtype=np.int16)
+    packets = []
+    latencies = []
+    for offset in range(0, len(audio) - frame_size + 1, frame_size):
+        start = time.perf_counter()
+        frame = capture.run(lambda o: audio[o:o + frame_size].copy(), offset)
+        pcm = resample.run(resampler.process, frame)
+        pending = np.concatenate([pending, pcm])
+        while len(pending) >= encode_frame_size:
+            chunk, pending = pending[:encode_frame_size], pending[encode_frame_size:]
+            opus = encode.run(encoder.encode, chunk.tobytes(), encode_frame_size)
+            packets.append(packetize.run(lambda p: struct.pack(">BBH", 0, 0, len(p)) + p, opus))
+        latencies.append(time.perf_counter() - start)
+
+    with open(output_file, "wb") as f:
+        for packet in packets:
+            f.write(packet)
+
+    audio_seconds = len(audio) / sample_rate
+    print(f"Uplink: {input_file} ({sample_rate}Hz, {audio_seconds:.2f}s) -> {output_file} ({len(packets)} packets)")
+    for stage in stages:
+        stage.report(audio_seconds)
+    report_latency(latencies)
+
+
+def run_downlink(input_file, output_file, output_sample_rate, input_sample_rate):
+    packets = read_p3(input_file)
+    frame_size = input_sample_rate * FRAME_DURATION_MS // 1000
+
+    decoder = opuslib.Decoder(input_sample_rate, 1)
+    resampler = StreamResampler(input_sample_rate, output_sample_rate)
+    stages = [StageStats("decode"), StageStats("resample"), StageStats("output")]
+    decode, resample, output = stages
+
+    frames = []
+    latencies = []
+    for packet in packets:
+        start = time.perf_counter()
+        pcm = decode.run(lambda p: np.frombuffer(decoder.decode(p, frame_size), dtype=np.int16), packet)
+        pcm = resample.run(resampler.process, pcm)
+        output.run(frames.append, pcm)
+        latencies.append(time.perf_counter() - start)
+
+    audio = np.concatenate(frames) if frames else np.zeros(0, dtype=np.int16)
+    if output_file:
+        sf.write(output_file, audio, output_sample_rate, subtype="PCM_16")
+
+    audio_seconds = len(packets) * FRAME_DURATION_MS / 1000
+    print(f"Downlink: {input_file} ({len(packets)} packets, {audio_seconds:.2f}s) -> {output_sample_rate}Hz")
+    for stage in stages:
+        stage.report(audio_seconds)
+    report_latency(latencies)
+
+
+def report_latency(latencies):
+    if not latencies:
+        return
+    values = np.array(latencies) * 1000
+    # End-to-end latency adds one frame of buffering to the processing time
+    print(f"  end-to-end   frame={FRAME_DURATION_MS}ms + processing avg={values.mean():.3f}ms "
+          f"p99={np.percentile(values, 99):.3f}ms max={values.max():.3f}ms")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Replay recorded WAV and P3 files through a model of the audio stages")
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    uplink = subparsers.add_parser("uplink", help="WAV -> resample -> opus encode -> P3")
+    uplink.add_argument("input_file", help="Input WAV file")
+    uplink.add_argument("output_file", help="Output P3 file")
+    uplink.add_argument("-c", "--complexity", type=int, default=3,
+                        help="Opus encoder complexity (default: 3, same as WiFi boards)")
+
+    downlink = subparsers.add_parser("downlink", help="P3 -> opus decode -> resample -> WAV")
+    downlink.add_argument("input_file", help="Input P3 file")
+    downlink.add_argument("output_file", nargs="?", help="Optional output WAV file")
+    downlink.add_argument("-r", "--output-rate", type=int, default=24000,
+                          help="Codec output sample rate (default: 24000)")
+    downlink.add_argument("-i", "--input-rate", type=int, default=16000,
+                          help="Sample rate of the P3 stream (default: 16000)")
+
+    args = parser.parse_args()
+    tracemalloc.start()
+    if args.command == "uplink":
+        run_uplink(args.input_file, args.output_file, args.complexity)
+    else:
+        run_downlink(args.input_file, args.output_file, args.output_rate, args.input_rate)
@@ -2,6 +2,10 @@ import sys
 import os
 import json
 import zipfile
+import struct
+import hashlib
+import random
+import zlib
 
 # 切换到项目根目录
 os.chdir(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
@@ -41,6 +45,131 @@ def zip_bin(board_type, project_version):
     print(f"zip bin to {output_path} done")
     
 
+# 差分升级补丁，格式见 main/ota_patch.h
+PATCH_MAGIC = 0x50445A58  # "XZDP"
+PATCH_VERSION = 1
+PATCH_HEADER_FORMAT = "<IHHII32s32s"
+PATCH_BLOCK_SIZE = 16
+PATCH_MIN_MATCH = 32
+
+def extend_match(old, old_pos, new, new_pos):
+    # 先按块比较完全相同的部分，再像 bsdiff 一样向后做近似匹配
+    length = 0
+    while old[old_pos + length:old_pos + length + 64] == new[new_pos + length:new_pos + length + 64] \
+            and old_pos + length + 64 <= len(old) and new_pos + length + 64 <= len(new):
+        length += 64
+    best_length = length
+    score = best_score = 0
+    i = length
+    while old_pos + i < len(old) and new_pos + i < len(new) and i - best_length < 256:
+        score += 1 if old[old_pos + i] == new[new_pos + i] else -1
+        i += 1
+        if score > best_score:
+            best_score = score
+            best_length = i
+    return best_length
+
+def create_patch(old, new):
+    # 固件代码基本按 4 字节对齐，只索引对齐的位置以节省内存
+    index = {}
+    for i in range(0, len(old) - PATCH_BLOCK_SIZE + 1, 4):
+        index.setdefault(old[i:i + PATCH_BLOCK_SIZE], i)
+
+    matches = []
+    pos = 0
+    last_old_end = last_new_end = 0
+    while pos <= len(new) - PATCH_BLOCK_SIZE:
+        block = new[pos:pos + PATCH_BLOCK_SIZE]
+        # 优先延续上一个匹配在旧固件中的位置
+        expected = last_old_end + (pos - last_new_end)
+        if 0 <= expected <= len(old) - PATCH_BLOCK_SIZE and old[expected:expected + PATCH_BLOCK_SIZE] == block:
+            old_pos = expected
+        else:
+            old_pos = index.get(block)
+        if old_pos is None:
+            pos += 1
+            continue
+        length = extend_match(old, old_pos, new, pos)
+        if length < PATCH_MIN_MATCH:
+            pos += 1
+            continue
+        matches.append((pos, old_pos, length))
+        last_old_end, last_new_end = old_pos + length, pos + length
+        pos += length
+
+    # 每条命令: 与旧固件相加的 diff、直接写入的 extra、旧固件位置的偏移
+    commands = bytearray()
+    new_pos = old_pos = 0
+    diff_len = 0
+    for match_new, match_old, length in matches + [(len(new), None, 0)]:
+        diff = bytes((new[new_pos + i] - old[old_pos + i]) & 0xFF for i in range(diff_len))
+        extra = new[new_pos + diff_len:match_new]
+        seek = (match_old - (old_pos + diff_len)) if match_old is not None else 0
+        commands += struct.pack("<IIi", diff_len, len(extra), seek) + diff + extra
+        new_pos, old_pos, diff_len = match_new, match_old, length
+
+    header = struct.pack(PATCH_HEADER_FORMAT, PATCH_MAGIC, PATCH_VERSION, 0, len(old), len(new),
+                         hashlib.sha256(old).digest(), hashlib.sha256(new).digest())
+    return header + zlib.compress(bytes(commands), 9)
+
+def apply_patch(old, patch):
+    header_size = struct.calcsize(PATCH_HEADER_FORMAT)
+    magic, version, _, source_size, target_size, source_sha256, target_sha256 = \
+        struct.unpack_from(PATCH_HEADER_FORMAT, patch, 0)
+    if magic != PATCH_MAGIC or version != PATCH_VERSION:
+        raise ValueError("Not a firmware patch")
+    if hashlib.sha256(old[:source_size]).digest() != source_sha256:
+        raise ValueError("Patch was not generated for this image")
+    commands = zlib.decompress(patch[header_size:])
+    new = bytearray()
+    pos = old_pos = 0
+    while pos < len(commands):
+        diff_len, extra_len, seek = struct.unpack_from("<IIi", commands, pos)
+        pos += 12
+        for i in range(diff_len):
+            new.append((old[old_pos + i] + commands[pos + i]) & 0xFF)
+        pos += diff_len
+        new += commands[pos:pos + extra_len]
+        pos += extra_len
+        old_pos += diff_len + seek
+    if len(new) != target_size or hashlib.sha256(new).digest() != target_sha256:
+        raise ValueError("SHA-256 of the patched image does not match")
+    return bytes(new)
+
+def make_patch(old_path, new_path, output_path):
+    with open(old_path, "rb") as f:
+        old = f.read()
+    with open(new_path, "rb") as f:
+        new = f.read()
+    patch = create_patch(old, new)
+    apply_patch(old, patch)
+    with open(output_path, "wb") as f:
+        f.write(patch)
+    print(f"patch {old_path} -> {new_path}: {len(patch)} bytes ({len(patch) * 100 / len(new):.1f}% of {len(new)})")
+
+def test_patch():
+    # 模拟固件变化：插入、删除、整段地址偏移，验证还原后的 SHA-256
+    rng = random.Random(0)
+    old = bytearray()
+    while len(old) < 256 * 1024:
+        old += rng.choice([bytes(rng.getrandbits(8) for _ in range(64)), b"\0" * 64, b"\xff" * 32])
+    cases = {"identical": bytes(old), "empty": b""}
+    new = bytearray(old)
+    new[1000:1000] = bytes(rng.getrandbits(8) for _ in range(300))
+    del new[50000:52000]
+    for i in range(80000, 120000, 4):
+        word = struct.unpack_from("<I", new, i)[0]
+        struct.pack_into("<I", new, i, (word + 0x40) & 0xFFFFFFFF)
+    new += bytes(rng.getrandbits(8) for _ in range(5000))
+    cases["modified"] = bytes(new)
+    cases["random"] = bytes(rng.getrandbits(8) for _ in range(64 * 1024))
+    for name, target in cases.items():
+        patch = create_patch(bytes(old), target)
+        if apply_patch(bytes(old), patch) != target:
+            print(f"{name}: FAILED")
+            sys.exit(1)
+        print(f"{name}: {len(target)} bytes, patch {len(patch)} bytes, sha256 OK")
+
 def release_current():
     merge_bin()
     board_type = get_board_type()
@@ -119,7 +248,14 @@ def release(board_type, board_config):
         print("-" * 80)
 
 if __name__ == "__main__":
-    if len(sys.argv) > 1:
+    if len(sys.argv) > 1 and sys.argv[1] == "patch":
+        if len(sys.argv) != 5:
+            print("用法: release.py patch <old.bin> <new.bin> <output.patch>")
+            sys.exit(1)
+        make_patch(sys.argv[2], sys.argv[3], sys.argv[4])
+    elif len(sys.argv) > 1 and sys.argv[1] == "test-patch":
+        test_patch()
+    elif len(sys.argv) > 1:
         board_configs = get_all_board_types()
         found = False
         for board_config, board_type in board_configs.items():
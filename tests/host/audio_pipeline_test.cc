@@ -0,0 +1,260 @@
+// Host test of the audio chain around the codec: AudioCodec, the resampling stages of
+// Application::ReadAudio and the decoder, and AudioMixer, driven frame by frame like
+// OnAudioInput / OnAudioOutput through a codec that reads and writes raw PCM files.
+// The resampler is the linear stand-in from stubs/opus_resampler.h.
+#include "audio_codecs/audio_codec.h"
+#include "audio_processing/audio_mixer.h"
+#include "settings.h"
+
+#include <opus_resampler.h>
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) do {                                               \
+        if (!(condition)) {                                                 \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+#define FRAME_DURATION_MS 60
+
+// Only the audio volume is read and written by the codec, keep it in memory
+static std::map<std::string, int32_t> settings_values;
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
+    auto it = settings_values.find(ns_ + "." + key);
+    return it == settings_values.end() ? default_value : it->second;
+}
+
+void Settings::SetInt(const std::string& key, int32_t value) {
+    if (read_write_) {
+        settings_values[ns_ + "." + key] = value;
+    }
+}
+
+// The software reference is not enabled on the host, the estimator task is never created
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, unsigned int stack_depth,
+    void* parameters, unsigned int priority, TaskHandle_t* created_task) {
+    return pdFAIL;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+    return 0;
+}
+
+// Reads the microphone from one file and plays to another, mono 16-bit PCM
+class FileAudioCodec : public AudioCodec {
+public:
+    FileAudioCodec(int input_sample_rate, int output_sample_rate, const char* input_file, const char* output_file) {
+        duplex_ = true;
+        input_sample_rate_ = input_sample_rate;
+        output_sample_rate_ = output_sample_rate;
+        input_ = input_file != nullptr ? fopen(input_file, "rb") : nullptr;
+        output_ = output_file != nullptr ? fopen(output_file, "wb") : nullptr;
+    }
+
+    virtual ~FileAudioCodec() {
+        if (input_ != nullptr) {
+            fclose(input_);
+        }
+        if (output_ != nullptr) {
+            fclose(output_);
+        }
+    }
+
+private:
+    FILE* input_ = nullptr;
+    FILE* output_ = nullptr;
+
+    virtual int Read(int16_t* dest, int samples) override {
+        return input_ != nullptr ? fread(dest, sizeof(int16_t), samples, input_) : 0;
+    }
+
+    virtual int Write(const int16_t* data, int samples) override {
+        return output_ != nullptr ? fwrite(data, sizeof(int16_t), samples, output_) : 0;
+    }
+};
+
+static void WritePcmFile(const char* path, const std::vector<int16_t>& pcm) {
+    FILE* file = fopen(path, "wb");
+    fwrite(pcm.data(), sizeof(int16_t), pcm.size(), file);
+    fclose(file);
+}
+
+static std::vector<int16_t> ReadPcmFile(const char* path) {
+    std::vector<int16_t> pcm;
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return pcm;
+    }
+    int16_t buffer[1024];
+    size_t count;
+    while ((count = fread(buffer, sizeof(int16_t), 1024, file)) > 0) {
+        pcm.insert(pcm.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return pcm;
+}
+
+static std::vector<int16_t> Sine(int sample_rate, int frequency, int amplitude, int samples) {
+    std::vector<int16_t> pcm(samples);
+    for (int i = 0; i < samples; i++) {
+        pcm[i] = amplitude * std::sin(2 * M_PI * frequency * i / sample_rate);
+    }
+    return pcm;
+}
+
+// Capture at 24000Hz, resampled to 16000Hz in 30ms frames like ReadAudio without an audio processor
+static void TestInputIsResampled() {
+    const int input_sample_rate = 24000;
+    // A partly filled last frame is not trimmed by InputData, the file holds whole frames
+    const int frames = 50;
+    const int frame_samples = 30 * input_sample_rate / 1000;
+    WritePcmFile("pipeline_input.pcm", Sine(input_sample_rate, 1000, 8000, frames * frame_samples));
+
+    FileAudioCodec codec(input_sample_rate, 24000, "pipeline_input.pcm", nullptr);
+    codec.Start();
+    CHECK(codec.input_enabled());
+    CHECK(codec.input_channels() == 1);
+
+    OpusResampler resampler;
+    resampler.Configure(codec.input_sample_rate(), 16000);
+    std::vector<int16_t> output;
+    while (true) {
+        std::vector<int16_t> data(30 * 16000 / 1000 * codec.input_sample_rate() / 16000);
+        CHECK((int)data.size() == frame_samples);
+        if (!codec.InputData(data)) {
+            break;
+        }
+        std::vector<int16_t> resampled(resampler.GetOutputSamples(data.size()));
+        resampler.Process(data.data(), data.size(), resampled.data());
+        output.insert(output.end(), resampled.begin(), resampled.end());
+    }
+
+    CHECK(output.size() == (size_t)frames * 30 * 16000 / 1000);
+    int crossings = 0;
+    int peak = 0;
+    for (size_t i = 1; i < output.size(); i++) {
+        if ((output[i - 1] < 0) != (output[i] < 0)) {
+            crossings++;
+        }
+        peak = std::max(peak, std::abs((int)output[i]));
+    }
+    // 1000Hz crosses zero twice per millisecond
+    CHECK(std::abs(crossings - frames * 30 * 2) <= 4);
+    CHECK(peak > 7500 && peak <= 8000);
+}
+
+// Server voice at 16000Hz resampled to the codec rate, a local sound ducks it while playing,
+// mixed frame by frame like OnAudioOutput and played into a file
+static void TestOutputIsMixedAndDucked() {
+    const int output_sample_rate = 24000;
+    const int frames = 12;
+    const int frame_samples = output_sample_rate * FRAME_DURATION_MS / 1000;
+
+    auto codec = new FileAudioCodec(16000, output_sample_rate, nullptr, "pipeline_output.pcm");
+    codec->Start();
+
+    AudioMixer mixer;
+    mixer.Initialize(output_sample_rate);
+    mixer.SetDucking(kAudioMixerChannelVoice, kAudioMixerChannelSound, 0.3f);
+    OpusResampler voice_resampler;
+    voice_resampler.Configure(16000, output_sample_rate);
+    OpusResampler sound_resampler;
+    sound_resampler.Configure(16000, output_sample_rate);
+
+    int voice_frames = 0;
+    int sound_frames = 0;
+    size_t played = 0;
+    for (int frame = 0; frame < frames + 2; frame++) {
+        if (voice_frames < frames && mixer.Available(kAudioMixerChannelVoice) == 0) {
+            std::vector<int16_t> voice(16000 * FRAME_DURATION_MS / 1000, 10000);
+            std::vector<int16_t> pcm(voice_resampler.GetOutputSamples(voice.size()));
+            voice_resampler.Process(voice.data(), voice.size(), pcm.data());
+            mixer.Write(kAudioMixerChannelVoice, pcm);
+            voice_frames++;
+        }
+        // A silent sound still holds the ducking, only the gain of the voice is measured
+        if (frame >= 3 && sound_frames < 3 && mixer.Available(kAudioMixerChannelSound) == 0) {
+            std::vector<int16_t> sound(16000 * FRAME_DURATION_MS / 1000, 0);
+            std::vector<int16_t> pcm(sound_resampler.GetOutputSamples(sound.size()));
+            sound_resampler.Process(sound.data(), sound.size(), pcm.data());
+            mixer.Write(kAudioMixerChannelSound, pcm);
+            sound_frames++;
+        }
+        std::vector<int16_t> pcm;
+        if (mixer.Mix(pcm)) {
+            CHECK((int)pcm.size() == frame_samples);
+            codec->OutputData(pcm);
+            played += pcm.size();
+        }
+    }
+    CHECK(mixer.IsEmpty());
+    // Closes the output file
+    delete codec;
+
+    auto output = ReadPcmFile("pipeline_output.pcm");
+    CHECK(output.size() == played);
+    CHECK(output.size() == (size_t)frames * frame_samples);
+    if (output.size() != (size_t)frames * frame_samples) {
+        return;
+    }
+    auto middle = [&](int frame) { return output[frame * frame_samples + frame_samples / 2]; };
+    CHECK(middle(1) == 10000);
+    // Ducked to 0.3 while the sound plays and for 300ms after it ends
+    CHECK(std::abs(middle(4) - 3000) <= 10);
+    CHECK(std::abs(middle(8) - 3000) <= 10);
+    CHECK(middle(11) == 10000);
+}
+
+static void TestMixerClampsAndWaitsForChannels() {
+    AudioMixer mixer;
+    mixer.Initialize(16000);
+
+    // The sum of two full scale channels saturates instead of wrapping
+    mixer.Write(kAudioMixerChannelVoice, std::vector<int16_t>(960, 30000));
+    mixer.Write(kAudioMixerChannelSound, std::vector<int16_t>(480, 30000));
+    std::vector<int16_t> pcm;
+    CHECK(mixer.Mix(pcm));
+    // Only as many samples as the shorter channel holds, the rest waits for its next frame
+    CHECK(pcm.size() == 480);
+    CHECK(pcm[240] == INT16_MAX);
+    CHECK(mixer.Available(kAudioMixerChannelVoice) == 480);
+
+    CHECK(mixer.Mix(pcm));
+    CHECK(pcm.size() == 480);
+    CHECK(pcm[240] == 30000);
+    CHECK(!mixer.Mix(pcm));
+}
+
+int main() {
+    TestInputIsResampled();
+    TestOutputIsMixedAndDucked();
+    TestMixerClampsAndWaitsForChannels();
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All audio pipeline tests passed\n");
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Host benchmark of the per-frame cost of the emotion animation: decode one RLE frame
+// from the atlas with the firmware decoder, then blit it into the emotion region of a
+// full RGB565 frame buffer.
+//
+//   emotion_blit_benchmark [atlas.bin] [screen_width screen_height]
+//
+// Without an atlas a synthetic one is generated and the decoded frames are checked
+// against the source pixels. Atlases are made with scripts/emotion_atlas.py.
+#include "display/emotion_atlas.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#define SYNTHETIC_EMOTIONS 8
+#define SYNTHETIC_FRAMES 10
+#define SYNTHETIC_SIZE 64
+#define SYNTHETIC_FPS 10
+#define BENCHMARK_ROUNDS 50
+
+static void Append(std::vector<uint8_t>& out, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+static std::vector<uint16_t> SyntheticFrame(int emotion, int frame) {
+    // A face-like disc that moves between frames on a flat background, similar to the real GIFs
+    std::vector<uint16_t> pixels(SYNTHETIC_SIZE * SYNTHETIC_SIZE);
+    int cx = SYNTHETIC_SIZE / 2 + frame % 5 - 2;
+    int cy = SYNTHETIC_SIZE / 2 + emotion % 3 - 1;
+    int radius = SYNTHETIC_SIZE / 3;
+    for (int y = 0; y < SYNTHETIC_SIZE; y++) {
+        for (int x = 0; x < SYNTHETIC_SIZE; x++) {
+            int dx = x - cx;
+            int dy = y - cy;
+            uint16_t color = 0xFFFF;
+            if (dx * dx + dy * dy < radius * radius) {
+                color = 0xFE60 - (uint16_t)(((dy + radius) / 8) << 6);
+            }
+            pixels[y * SYNTHETIC_SIZE + x] = color;
+        }
+    }
+    return pixels;
+}
+
+static std::vector<uint8_t> EncodeRle(const std::vector<uint16_t>& pixels) {
+    std::vector<uint8_t> runs;
+    for (size_t i = 0; i < pixels.size();) {
+        uint16_t color = pixels[i];
+        uint16_t count = 1;
+        while (i + count < pixels.size() && pixels[i + count] == color && count < 0xFFFF) {
+            count++;
+        }
+        Append(runs, &count, sizeof(count));
+        Append(runs, &color, sizeof(color));
+        i += count;
+    }
+    return runs;
+}
+
+static std::vector<uint8_t> SyntheticAtlas(std::vector<std::vector<uint16_t>>& source) {
+    EmotionAtlasHeader header = {EMOTION_ATLAS_MAGIC, EMOTION_ATLAS_VERSION, SYNTHETIC_EMOTIONS,
+        SYNTHETIC_EMOTIONS * SYNTHETIC_FRAMES, SYNTHETIC_SIZE, SYNTHETIC_SIZE, SYNTHETIC_FPS};
+    std::vector<uint8_t> atlas;
+    Append(atlas, &header, sizeof(header));
+    for (int i = 0; i < SYNTHETIC_EMOTIONS; i++) {
+        EmotionAtlasEmotion emotion = {};
+        snprintf(emotion.name, sizeof(emotion.name), "emotion%d", i);
+        emotion.first_frame = i * SYNTHETIC_FRAMES;
+        emotion.frame_count = SYNTHETIC_FRAMES;
+        Append(atlas, &emotion, sizeof(emotion));
+    }
+
+    std::vector<uint8_t> data;
+    size_t data_offset = atlas.size() + header.frame_count * sizeof(EmotionAtlasFrame);
+    for (int i = 0; i < SYNTHETIC_EMOTIONS; i++) {
+        for (int j = 0; j < SYNTHETIC_FRAMES; j++) {
+            source.push_back(SyntheticFrame(i, j));
+            auto runs = EncodeRle(source.back());
+            EmotionAtlasFrame frame = {(uint32_t)(data_offset + data.size()), (uint32_t)runs.size()};
+            Append(atlas, &frame, sizeof(frame));
+            data.insert(data.end(), runs.begin(), runs.end());
+        }
+    }
+    atlas.insert(atlas.end(), data.begin(), data.end());
+    return atlas;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<uint8_t> atlas;
+    std::vector<std::vector<uint16_t>> source;
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "Cannot open %s\n", argv[1]);
+            return 1;
+        }
+        atlas.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        atlas = SyntheticAtlas(source);
+    }
+    int screen_width = argc > 3 ? atoi(argv[2]) : 240;
+    int screen_height = argc > 3 ? atoi(argv[3]) : 240;
+
+    if (atlas.size() < sizeof(EmotionAtlasHeader)) {
+        fprintf(stderr, "Atlas too small\n");
+        return 1;
+    }
+    auto header = reinterpret_cast<const EmotionAtlasHeader*>(atlas.data());
+    if (header->magic != EMOTION_ATLAS_MAGIC || header->version != EMOTION_ATLAS_VERSION) {
+        fprintf(stderr, "Not an emotion atlas\n");
+        return 1;
+    }
+    if (header->frame_count == 0) {
+        fprintf(stderr, "Atlas has no frames\n");
+        return 1;
+    }
+    if (header->width > screen_width || header->height > screen_height) {
+        fprintf(stderr, "Frames of %dx%d do not fit the %dx%d screen\n", header->width, header->height, screen_width, screen_height);
+        return 1;
+    }
+    auto frames = reinterpret_cast<const EmotionAtlasFrame*>(atlas.data() + sizeof(EmotionAtlasHeader) +
+        header->emotion_count * sizeof(EmotionAtlasEmotion));
+    size_t total = header->width * header->height;
+
+    std::vector<uint16_t> pixels(total);
+    std::vector<uint16_t> screen(screen_width * screen_height);
+    int region_x = (screen_width - header->width) / 2;
+    int region_y = (screen_height - header->height) / 2;
+
+    for (int i = 0; i < header->frame_count; i++) {
+        if (frames[i].offset + frames[i].size > atlas.size() || frames[i].size % 4 != 0) {
+            fprintf(stderr, "Invalid frame %d\n", i);
+            return 1;
+        }
+        if (!source.empty()) {
+            DecodeEmotionFrame((const uint16_t*)(atlas.data() + frames[i].offset), frames[i].size / 4, pixels.data(), total);
+            if (pixels != source[i]) {
+                fprintf(stderr, "Frame %d does not match the source pixels\n", i);
+                return 1;
+            }
+        }
+    }
+
+    double total_us = 0;
+    double max_us = 0;
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+        for (int i = 0; i < header->frame_count; i++) {
+            auto start = std::chrono::steady_clock::now();
+            DecodeEmotionFrame((const uint16_t*)(atlas.data() + frames[i].offset), frames[i].size / 4, pixels.data(), total);
+            // Only the rows of the emotion region are copied, the rest of the screen is untouched
+            for (int y = 0; y < header->height; y++) {
+                std::copy_n(&pixels[y * header->width], header->width, &screen[(region_y + y) * screen_width + region_x]);
+            }
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            total_us += us;
+            max_us = std::max(max_us, us);
+        }
+    }
+
+    int count = BENCHMARK_ROUNDS * header->frame_count;
+    double region_share = 100.0 * total / (screen_width * screen_height);
+    printf("%d frames of %dx%d (%.1f%% of %dx%d screen) at %d fps, frame budget %.0f us\n",
+        header->frame_count, header->width, header->height, region_share, screen_width, screen_height,
+        header->fps, header->fps > 0 ? 1000000.0 / header->fps : 0.0);
+    printf("Decode + blit per frame: avg %.2f us, max %.2f us, %.1f KB RLE\n",
+        total_us / count, max_us, (atlas.size() - frames[0].offset) / 1024.0);
+    return 0;
+}
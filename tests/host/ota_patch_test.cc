@@ -0,0 +1,299 @@
+// Host test of OtaPatch: a patch made by scripts/release.py from two sample images is
+// streamed in small chunks like Ota::UpgradeWithPatch, the running partition holds the
+// old image and the update partition is rebuilt in memory through OtaWriter.
+#include "ota_patch.h"
+
+#include <freertos/task.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) do {                                               \
+        if (!(condition)) {                                                 \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+#define PARTITION_SIZE (1024 * 1024)
+
+// The writer task runs on a thread, queues are blocking deques
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, unsigned int stack_depth,
+    void* parameters, unsigned int priority, TaskHandle_t* created_task) {
+    static int next_handle = 1;
+    std::thread(function, parameters).detach();
+    if (created_task != nullptr) {
+        *created_task = (TaskHandle_t)(intptr_t)next_handle++;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+}
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    unsigned int length;
+    unsigned int item_size;
+};
+
+QueueHandle_t xQueueCreate(unsigned int length, unsigned int item_size) {
+    auto queue = new QueueDefinition;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto has_space = [queue] { return queue->items.size() < queue->length; };
+    if (ticks_to_wait == portMAX_DELAY) {
+        queue->cv.wait(lock, has_space);
+    } else if (!queue->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), has_space)) {
+        return pdFALSE;
+    }
+    auto data = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(data, data + queue->item_size);
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto has_item = [queue] { return !queue->items.empty(); };
+    if (ticks_to_wait == portMAX_DELAY) {
+        queue->cv.wait(lock, has_item);
+    } else if (!queue->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), has_item)) {
+        return pdFALSE;
+    }
+    if (queue->item_size > 0) {
+        memcpy(buffer, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+// Flash of the two app partitions, erased to 0xFF
+static esp_partition_t running_partition = { 0x10000, PARTITION_SIZE, "ota_0" };
+static esp_partition_t update_partition = { 0x10000 + PARTITION_SIZE, PARTITION_SIZE, "ota_1" };
+static std::vector<uint8_t> running_flash;
+static std::vector<uint8_t> update_flash;
+static int ota_begin_count = 0;
+static bool ota_open = false;
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    CHECK(partition == &running_partition);
+    if (src_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(dst, running_flash.data() + src_offset, size);
+    return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+    return &running_partition;
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    return &update_partition;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    CHECK(partition == &update_partition);
+    update_flash.clear();
+    ota_begin_count++;
+    ota_open = true;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    if (update_flash.size() + size > PARTITION_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto bytes = static_cast<const uint8_t*>(data);
+    update_flash.insert(update_flash.end(), bytes, bytes + size);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    ota_open = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    ota_open = false;
+    return ESP_OK;
+}
+
+// Deterministic bytes, so that the images are the same on every run
+static uint32_t random_state = 1;
+
+static uint8_t RandomByte() {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 16;
+}
+
+// Code, zero filled data and erased flash, like a firmware image
+static std::vector<uint8_t> MakeOldImage() {
+    std::vector<uint8_t> image;
+    while (image.size() < 256 * 1024) {
+        switch (RandomByte() % 3) {
+        case 0:
+            for (int i = 0; i < 64; i++) {
+                image.push_back(RandomByte());
+            }
+            break;
+        case 1:
+            image.insert(image.end(), 64, 0);
+            break;
+        default:
+            image.insert(image.end(), 32, 0xFF);
+            break;
+        }
+    }
+    return image;
+}
+
+// Inserted and removed code, and a range of addresses moved by a relink
+static std::vector<uint8_t> MakeNewImage(const std::vector<uint8_t>& old) {
+    std::vector<uint8_t> image(old);
+    std::vector<uint8_t> inserted(300);
+    for (auto& byte : inserted) {
+        byte = RandomByte();
+    }
+    image.insert(image.begin() + 1000, inserted.begin(), inserted.end());
+    image.erase(image.begin() + 50000, image.begin() + 52000);
+    for (size_t i = 80000; i < 120000; i += 4) {
+        uint32_t word;
+        memcpy(&word, &image[i], 4);
+        word += 0x40;
+        memcpy(&image[i], &word, 4);
+    }
+    for (int i = 0; i < 5000; i++) {
+        image.push_back(RandomByte());
+    }
+    return image;
+}
+
+static void WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& path) {
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return data;
+    }
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return data;
+}
+
+static void FlashRunningImage(const std::vector<uint8_t>& image) {
+    running_flash.assign(PARTITION_SIZE, 0xFF);
+    std::copy(image.begin(), image.end(), running_flash.begin());
+}
+
+// Streams the patch in chunks that do not line up with the header or the commands
+static bool ApplyPatch(const std::vector<uint8_t>& patch, bool& write_ok) {
+    OtaPatch ota_patch;
+    write_ok = true;
+    for (size_t offset = 0; offset < patch.size(); offset += 1000) {
+        size_t n = std::min((size_t)1000, patch.size() - offset);
+        if (!ota_patch.Write(patch.data() + offset, n)) {
+            write_ok = false;
+            return false;
+        }
+    }
+    return ota_patch.Finish();
+}
+
+static void TestPatchRebuildsTarget(const std::vector<uint8_t>& old_image, const std::vector<uint8_t>& new_image,
+    const std::vector<uint8_t>& patch) {
+    FlashRunningImage(old_image);
+    ota_begin_count = 0;
+    bool write_ok;
+    CHECK(ApplyPatch(patch, write_ok));
+    CHECK(write_ok);
+    CHECK(ota_begin_count == 1);
+    CHECK(!ota_open);
+    CHECK(update_flash == new_image);
+}
+
+// Another running firmware must be rejected before anything is written to the update partition
+static void TestWrongSourceIsRejected(const std::vector<uint8_t>& old_image, const std::vector<uint8_t>& patch) {
+    auto image = old_image;
+    image[image.size() / 2] ^= 0x01;
+    FlashRunningImage(image);
+    ota_begin_count = 0;
+    bool write_ok;
+    CHECK(!ApplyPatch(patch, write_ok));
+    CHECK(!write_ok);
+    CHECK(ota_begin_count == 0);
+}
+
+// The rebuilt image is checked against the target hash from the header
+static void TestTargetHashIsChecked(const std::vector<uint8_t>& old_image, const std::vector<uint8_t>& patch) {
+    auto corrupted = patch;
+    corrupted[offsetof(OtaPatchHeader, target_sha256)] ^= 0x01;
+    FlashRunningImage(old_image);
+    bool write_ok;
+    CHECK(!ApplyPatch(corrupted, write_ok));
+    CHECK(write_ok);
+    CHECK(!ota_open);
+}
+
+int main(int argc, char* argv[]) {
+    std::string directory = argc > 1 ? argv[1] : ".";
+    auto old_image = MakeOldImage();
+    auto new_image = MakeNewImage(old_image);
+    WriteFile(directory + "/ota_patch_old.bin", old_image);
+    WriteFile(directory + "/ota_patch_new.bin", new_image);
+
+    std::string command = std::string(PYTHON_EXECUTABLE) + " " + RELEASE_SCRIPT + " patch " +
+        directory + "/ota_patch_old.bin " + directory + "/ota_patch_new.bin " + directory + "/ota_patch.bin";
+    if (std::system(command.c_str()) != 0) {
+        printf("Failed to generate the patch: %s\n", command.c_str());
+        return 1;
+    }
+    auto patch = ReadFile(directory + "/ota_patch.bin");
+    CHECK(patch.size() > sizeof(OtaPatchHeader));
+    CHECK(patch.size() < new_image.size() / 4);
+    if (patch.size() <= sizeof(OtaPatchHeader)) {
+        return 1;
+    }
+
+    TestPatchRebuildsTarget(old_image, new_image, patch);
+    TestWrongSourceIsRejected(old_image, patch);
+    TestTargetHashIsChecked(old_image, patch);
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All OTA patch tests passed\n");
+    return 0;
+}
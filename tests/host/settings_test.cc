@@ -0,0 +1,294 @@
+// Host test of the Settings cache against an in-memory NVS that counts flash writes.
+// Checks that reads are cached, that changes are coalesced into one deferred commit,
+// and that Flush and the shutdown handler write pending changes.
+#include "settings.h"
+
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <variant>
+
+static int failures = 0;
+
+#define CHECK(condition) do {                                               \
+        if (!(condition)) {                                                 \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+// In-memory NVS, values are only visible to readers after nvs_commit like on flash
+namespace {
+
+struct FakeNvs {
+    typedef std::map<std::string, std::map<std::string, std::variant<int32_t, std::string>>> Storage;
+    Storage committed;
+    Storage pending;
+    std::map<nvs_handle_t, std::string> handles;
+    nvs_handle_t next_handle = 1;
+    int reads = 0;
+    int writes = 0;
+    int commits = 0;
+};
+
+FakeNvs nvs;
+
+struct FakeTimer {
+    esp_timer_cb_t callback = nullptr;
+    void* arg = nullptr;
+    bool active = false;
+};
+
+FakeTimer timer;
+shutdown_handler_t shutdown_handler = nullptr;
+int tasks_created = 0;
+
+void FireTimer() {
+    if (timer.active) {
+        timer.active = false;
+        timer.callback(timer.arg);
+    }
+}
+
+} // namespace
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if (open_mode == NVS_READONLY && nvs.committed.count(name) == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_handle = nvs.next_handle++;
+    nvs.handles[*out_handle] = name;
+    if (open_mode == NVS_READWRITE) {
+        nvs.pending[name] = nvs.committed[name];
+    }
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    nvs.handles.erase(handle);
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    nvs.reads++;
+    auto& ns = nvs.committed[nvs.handles[handle]];
+    auto it = ns.find(key);
+    if (it == ns.end() || !std::holds_alternative<int32_t>(it->second)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = std::get<int32_t>(it->second);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    // A length query followed by the read counts as one read
+    if (out_value == nullptr) {
+        nvs.reads++;
+    }
+    auto& ns = nvs.committed[nvs.handles[handle]];
+    auto it = ns.find(key);
+    if (it == ns.end() || !std::holds_alternative<std::string>(it->second)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    auto& value = std::get<std::string>(it->second);
+    if (out_value != nullptr) {
+        if (*length < value.size() + 1) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        memcpy(out_value, value.c_str(), value.size() + 1);
+    }
+    *length = value.size() + 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    nvs.writes++;
+    nvs.pending[nvs.handles[handle]][key] = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    nvs.writes++;
+    nvs.pending[nvs.handles[handle]][key] = std::string(value);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    nvs.writes++;
+    return nvs.pending[nvs.handles[handle]].erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    nvs.writes++;
+    nvs.pending[nvs.handles[handle]].clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    nvs.commits++;
+    auto& name = nvs.handles[handle];
+    nvs.committed[name] = nvs.pending[name];
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    timer.callback = args->callback;
+    timer.arg = args->arg;
+    *out_handle = reinterpret_cast<esp_timer_handle_t>(&timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t handle, uint64_t timeout_us) {
+    timer.active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t handle) {
+    timer.active = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t handle) {
+    return timer.active;
+}
+
+int64_t esp_timer_get_time() {
+    return 0;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    shutdown_handler = handler;
+    return ESP_OK;
+}
+
+// Tasks run to completion in the caller
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, unsigned int stack_depth,
+    void* parameters, unsigned int priority, TaskHandle_t* created_task) {
+    tasks_created++;
+    function(parameters);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+}
+
+static void TestReadsAreCached() {
+    nvs.committed["audio"]["volume"] = 50;
+    nvs.committed["audio"]["name"] = std::string("speaker");
+    int reads = nvs.reads;
+    for (int i = 0; i < 10; i++) {
+        Settings settings("audio");
+        CHECK(settings.GetInt("volume", 70) == 50);
+        CHECK(settings.GetString("name") == "speaker");
+        CHECK(settings.GetInt("missing", 7) == 7);
+    }
+    // Each key is read from NVS once, a missing key is remembered as missing
+    CHECK(nvs.reads - reads == 3);
+}
+
+static void TestChangesAreCoalesced() {
+    int commits = nvs.commits;
+    for (int volume = 0; volume <= 100; volume += 10) {
+        Settings settings("audio", true);
+        settings.SetInt("volume", volume);
+    }
+    {
+        Settings settings("display", true);
+        settings.SetInt("brightness", 80);
+        settings.SetString("theme", "dark");
+    }
+    CHECK(nvs.commits == commits);
+    CHECK(timer.active);
+    // Changes are visible to readers before they are committed
+    CHECK(Settings("audio").GetInt("volume") == 100);
+
+    int tasks = tasks_created;
+    FireTimer();
+    // One commit per changed namespace, written from a task instead of the timer callback
+    CHECK(nvs.commits - commits == 2);
+    CHECK(tasks_created - tasks == 1);
+    CHECK(std::get<int32_t>(nvs.committed["audio"]["volume"]) == 100);
+    CHECK(std::get<int32_t>(nvs.committed["display"]["brightness"]) == 80);
+    CHECK(std::get<std::string>(nvs.committed["display"]["theme"]) == "dark");
+
+    // Nothing left to write
+    commits = nvs.commits;
+    FireTimer();
+    Settings::Flush();
+    CHECK(nvs.commits == commits);
+}
+
+static void TestUnchangedValueIsNotWritten() {
+    int writes = nvs.writes;
+    Settings settings("audio", true);
+    settings.SetInt("volume", 100);
+    CHECK(!timer.active);
+    Settings::Flush();
+    CHECK(nvs.writes == writes);
+}
+
+static void TestFlushAndErase() {
+    int commits = nvs.commits;
+    {
+        Settings settings("wifi", true);
+        settings.SetString("ssid", "home");
+        settings.SetString("password", "secret");
+    }
+    Settings::Flush();
+    CHECK(!timer.active);
+    CHECK(nvs.commits - commits == 1);
+    CHECK(std::get<std::string>(nvs.committed["wifi"]["ssid"]) == "home");
+
+    {
+        Settings settings("wifi", true);
+        settings.EraseKey("password");
+        CHECK(settings.GetString("password", "none") == "none");
+    }
+    Settings::Flush();
+    CHECK(nvs.committed["wifi"].count("password") == 0);
+    CHECK(nvs.committed["wifi"].count("ssid") == 1);
+
+    {
+        Settings settings("wifi", true);
+        settings.EraseAll();
+        settings.SetString("ssid", "office");
+        CHECK(settings.GetString("password", "none") == "none");
+    }
+    Settings::Flush();
+    CHECK(nvs.committed["wifi"].size() == 1);
+    CHECK(std::get<std::string>(nvs.committed["wifi"]["ssid"]) == "office");
+}
+
+static void TestReadOnlyIgnoresWrites() {
+    Settings settings("audio");
+    settings.SetInt("volume", 1);
+    CHECK(settings.GetInt("volume") == 100);
+    CHECK(!timer.active);
+}
+
+static void TestShutdownFlushes() {
+    Settings("audio", true).SetInt("volume", 30);
+    CHECK(shutdown_handler != nullptr);
+    shutdown_handler();
+    CHECK(!timer.active);
+    CHECK(std::get<int32_t>(nvs.committed["audio"]["volume"]) == 30);
+}
+
+int main() {
+    TestReadsAreCached();
+    TestChangesAreCoalesced();
+    TestUnchangedValueIsNotWritten();
+    TestFlushAndErase();
+    TestReadOnlyIgnoresWrites();
+    TestShutdownFlushes();
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All settings tests passed\n");
+    return 0;
+}
@@ -0,0 +1,2 @@
+// Host builds only need the include to resolve, the code under test does not use the board
+#pragma once
@@ -0,0 +1,8 @@
+#pragma once
+#include "esp_err.h"
+
+typedef struct i2s_channel_obj_t* i2s_chan_handle_t;
+
+inline esp_err_t i2s_channel_enable(i2s_chan_handle_t handle) {
+    return ESP_OK;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+#define pdPASS 1
+#define pdFAIL 0
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) (ms)
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
@@ -0,0 +1,10 @@
+#pragma once
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct QueueDefinition* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(unsigned int length, unsigned int item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait);
+void vQueueDelete(QueueHandle_t queue);
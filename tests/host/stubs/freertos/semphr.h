@@ -0,0 +1,9 @@
+#pragma once
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define xSemaphoreGive(semaphore) xQueueSend(semaphore, nullptr, 0)
+#define xSemaphoreTake(semaphore, ticks) xQueueReceive(semaphore, nullptr, ticks)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace iot {
+
+class ThingManager {
+public:
+    static ThingManager& GetInstance() {
+        static ThingManager instance;
+        return instance;
+    }
+    void NotifyPropertyChanged(const char* thing, const char* property) {}
+};
+
+} // namespace iot
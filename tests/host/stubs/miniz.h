@@ -0,0 +1,47 @@
+// Host stand-in for the tinfl part of miniz on top of zlib, for the
+// streaming use with a wrapping TINFL_LZ_DICT_SIZE output buffer
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <zlib.h>
+
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_PARSE_ZLIB_HEADER 1
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+typedef enum {
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+typedef struct tinfl_decompressor_tag {
+    z_stream stream;
+} tinfl_decompressor;
+
+// The zlib state is not released, the decompressor is freed with heap_caps_free
+inline void tinfl_init(tinfl_decompressor* decompressor) {
+    decompressor->stream = z_stream();
+    inflateInit(&decompressor->stream);
+}
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor* decompressor, const uint8_t* in_buf, size_t* in_buf_size,
+    uint8_t* out_buf_start, uint8_t* out_buf_next, size_t* out_buf_size, uint32_t flags) {
+    auto& stream = decompressor->stream;
+    stream.next_in = const_cast<uint8_t*>(in_buf);
+    stream.avail_in = *in_buf_size;
+    stream.next_out = out_buf_next;
+    stream.avail_out = *out_buf_size;
+    int ret = inflate(&stream, Z_NO_FLUSH);
+    *in_buf_size -= stream.avail_in;
+    *out_buf_size -= stream.avail_out;
+    if (ret == Z_STREAM_END) {
+        inflateEnd(&stream);
+        return TINFL_STATUS_DONE;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return TINFL_STATUS_FAILED;
+    }
+    return stream.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
@@ -0,0 +1,38 @@
+// Host stand-in for the esp-opus-encoder resampler, same interface with linear interpolation.
+// The sample counts match the real resampler, the filter response does not.
+#pragma once
+#include <cstdint>
+
+class OpusResampler {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate) {
+        input_sample_rate_ = input_sample_rate;
+        output_sample_rate_ = output_sample_rate;
+        last_ = 0;
+    }
+
+    int GetOutputSamples(int input_samples) const {
+        return (int64_t)input_samples * output_sample_rate_ / input_sample_rate_;
+    }
+
+    // Output sample i sits at (i + 1) * in / out of the input, 0 being the last sample of the previous frame
+    void Process(const int16_t* input, int input_samples, int16_t* output) {
+        int output_samples = GetOutputSamples(input_samples);
+        for (int i = 0; i < output_samples; i++) {
+            int64_t position = (int64_t)(i + 1) * input_sample_rate_;
+            int index = position / output_sample_rate_;
+            int fraction = position % output_sample_rate_;
+            int a = index == 0 ? last_ : input[index - 1];
+            int b = index < input_samples ? input[index] : a;
+            output[i] = a + (int64_t)(b - a) * fraction / output_sample_rate_;
+        }
+        if (input_samples > 0) {
+            last_ = input[input_samples - 1];
+        }
+    }
+
+private:
+    int input_sample_rate_ = 16000;
+    int output_sample_rate_ = 16000;
+    int16_t last_ = 0;
+};